@@ -1,80 +1,259 @@
 #include "Grapheme.hpp"
 
+#include <algorithm>
+
 #include "utf8proc/utf8proc.h"
 
 #include "Exceptions.hpp"
+#include "GraphemeBreak.hpp"
+#include "Utf8Tools.hpp"
 
 namespace unicpp
 {
 
 grapheme::grapheme(const std::u32string & codepoints) :
-    m_codepoints(codepoints)
+    grapheme(codepoints.data(), codepoints.size(), false)
 {
     //Check if it's a single grapheme
+    const grapheme_break_table& table = grapheme_break_table::get();
     utf8proc_int32_t state = 0;
-    for(std::size_t i = 0; i < m_codepoints.size() - 1; ++i)
+    for(std::size_t i = 0; i + 1 < m_size; ++i)
     {
-        if(utf8proc_grapheme_break_stateful(m_codepoints[i], m_codepoints[i + 1], &state))
+        if(table.is_break(data()[i], data()[i + 1], state))
             throw invalid_grapheme_exception("Found an grapheme break in a grapheme!");
     }
 }
 
+grapheme::grapheme(const grapheme & other) :
+    grapheme(other.data(), other.m_size, false)
+{
+
+}
+
+grapheme::grapheme(grapheme && other) noexcept :
+    m_size(0),
+    m_capacity(INLINE_CAPACITY)
+{
+    take(other);
+}
+
+grapheme& grapheme::operator=(const grapheme & other)
+{
+    if(this != &other)
+    {
+        m_size = 0;
+        reserve(other.m_size);
+        std::copy(other.data(), other.data() + other.m_size, data());
+        m_size = other.m_size;
+    }
+
+    return *this;
+}
+
+grapheme& grapheme::operator=(grapheme && other) noexcept
+{
+    if(this != &other)
+    {
+        if(m_capacity > INLINE_CAPACITY)
+            delete[] m_heap;
+
+        m_size = 0;
+        m_capacity = INLINE_CAPACITY;
+        take(other);
+    }
+
+    return *this;
+}
+
+grapheme::~grapheme()
+{
+    if(m_capacity > INLINE_CAPACITY)
+        delete[] m_heap;
+}
+
 std::size_t grapheme::codepoints_count() const
 {
-    return m_codepoints.size();
+    return m_size;
 }
 
-std::u32string::const_iterator grapheme::codepoints_begin() const
+const char32_t* grapheme::codepoints_begin() const
 {
-    return m_codepoints.cbegin();
+    return data();
 }
 
-std::u32string::const_iterator grapheme::codepoints_end() const
+const char32_t* grapheme::codepoints_end() const
 {
-    return m_codepoints.cend();
+    return data() + m_size;
 }
 
 char32_t grapheme::operator[](std::size_t i) const
 {
-    return m_codepoints[i];
+    return data()[i];
 }
 
 grapheme grapheme::get_compat() const
 {
-    std::u32string new_codepoints;
+    grapheme new_grapheme(nullptr, 0, false);
     for(std::size_t i = 0; i < codepoints_count(); ++i)
     {
-        std::size_t count = utf8proc_decompose_char(m_codepoints[i], nullptr, 0, UTF8PROC_COMPAT, nullptr);
+        std::size_t count = utf8proc_decompose_char((*this)[i], nullptr, 0, UTF8PROC_COMPAT, nullptr);
         utf8proc_int32_t decomposed_codepoints[count];
-        utf8proc_decompose_char(m_codepoints[i], decomposed_codepoints, count, UTF8PROC_COMPAT, nullptr);
+        utf8proc_decompose_char((*this)[i], decomposed_codepoints, count, UTF8PROC_COMPAT, nullptr);
 
         for(std::size_t j = 0; j < count; ++j)
-            new_codepoints.push_back(static_cast<char32_t>(decomposed_codepoints[j]));
+            new_grapheme.push_back(static_cast<char32_t>(decomposed_codepoints[j]));
     }
 
-    return grapheme(new_codepoints, false);
+    return new_grapheme;
 }
 
 grapheme grapheme::get_casefold() const
 {
-    std::u32string new_codepoints;
+    grapheme new_grapheme(nullptr, 0, false);
     for(std::size_t i = 0; i < codepoints_count(); ++i)
     {
-        std::size_t count = utf8proc_decompose_char(m_codepoints[i], nullptr, 0, UTF8PROC_CASEFOLD, nullptr);
+        std::size_t count = utf8proc_decompose_char((*this)[i], nullptr, 0, UTF8PROC_CASEFOLD, nullptr);
         utf8proc_int32_t decomposed_codepoints[count];
-        utf8proc_decompose_char(m_codepoints[i], decomposed_codepoints, count, UTF8PROC_CASEFOLD, nullptr);
+        utf8proc_decompose_char((*this)[i], decomposed_codepoints, count, UTF8PROC_CASEFOLD, nullptr);
 
         for(std::size_t j = 0; j < count; ++j)
-            new_codepoints.push_back(static_cast<char32_t>(decomposed_codepoints[j]));
+            new_grapheme.push_back(static_cast<char32_t>(decomposed_codepoints[j]));
     }
 
-    return grapheme(new_codepoints, false);
+    return new_grapheme;
 }
 
 grapheme::grapheme(const std::u32string & codepoints, bool) :
-    m_codepoints(codepoints)
+    grapheme(codepoints.data(), codepoints.size(), false)
 {
     // No checks at all in this special version
 }
 
+grapheme::grapheme(const char32_t * codepoints, std::size_t count, bool) :
+    m_size(0),
+    m_capacity(INLINE_CAPACITY)
+{
+    reserve(count);
+    std::copy(codepoints, codepoints + count, data());
+    m_size = static_cast<std::uint32_t>(count);
+}
+
+char32_t* grapheme::data()
+{
+    return (m_capacity > INLINE_CAPACITY) ? m_heap : m_inline;
+}
+
+const char32_t* grapheme::data() const
+{
+    return (m_capacity > INLINE_CAPACITY) ? m_heap : m_inline;
+}
+
+void grapheme::reserve(std::size_t capacity)
+{
+    if(capacity <= m_capacity)
+        return;
+
+    char32_t* storage = new char32_t[capacity];
+    std::copy(data(), data() + m_size, storage);
+    if(m_capacity > INLINE_CAPACITY)
+        delete[] m_heap;
+
+    m_heap = storage;
+    m_capacity = static_cast<std::uint32_t>(capacity);
+}
+
+void grapheme::take(grapheme & other) noexcept
+{
+    if(other.m_capacity > INLINE_CAPACITY)
+    {
+        // Steal the heap storage
+        m_heap = other.m_heap;
+        m_capacity = other.m_capacity;
+        other.m_capacity = INLINE_CAPACITY;
+    }
+    else
+    {
+        std::copy(other.m_inline, other.m_inline + other.m_size, m_inline);
+    }
+
+    m_size = other.m_size;
+    other.m_size = 0;
+}
+
+void grapheme::push_back(char32_t codepoint)
+{
+    if(m_size == m_capacity)
+        reserve(2 * m_capacity);
+
+    data()[m_size++] = codepoint;
+}
+
+grapheme_view::grapheme_view(const char* data, std::size_t begin_offset, std::size_t end_offset) :
+    m_data(data),
+    m_begin(begin_offset),
+    m_end(end_offset)
+{
+
+}
+
+grapheme_view::grapheme_view(const std::string & str, std::size_t begin_offset, std::size_t end_offset) :
+    grapheme_view(str.data(), begin_offset, end_offset)
+{
+
+}
+
+std::size_t grapheme_view::begin_offset() const
+{
+    return m_begin;
+}
+
+std::size_t grapheme_view::end_offset() const
+{
+    return m_end;
+}
+
+const char* grapheme_view::octets_begin() const
+{
+    return m_data + m_begin;
+}
+
+const char* grapheme_view::octets_end() const
+{
+    return m_data + m_end;
+}
+
+std::size_t grapheme_view::octets_count() const
+{
+    return m_end - m_begin;
+}
+
+std::size_t grapheme_view::codepoints_count() const
+{
+    return utf32_length_from_utf8(octets_begin(), octets_end());
+}
+
+char32_t grapheme_view::operator[](std::size_t i) const
+{
+    const char* it = octets_begin();
+    for(; i > 0; --i)
+        iterate_next(it, octets_end());
+
+    return iterate_next(it, octets_end());
+}
+
+grapheme grapheme_view::to_grapheme() const
+{
+    grapheme result(nullptr, 0, false);
+    result.reserve(codepoints_count());
+    char32_t* end = utf8_to_utf32(octets_begin(), octets_end(), result.data());
+    result.m_size = static_cast<std::uint32_t>(end - result.data());
+
+    return result;
+}
+
+grapheme_view::operator grapheme() const
+{
+    return to_grapheme();
+}
+
 }
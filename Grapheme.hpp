@@ -1,6 +1,7 @@
 #ifndef UNICPP_GRAPHEME_H
 #define UNICPP_GRAPHEME_H
 
+#include <cstdint>
 #include <string>
 
 namespace unicpp
@@ -13,16 +14,23 @@ class grapheme
 {
     template<typename StringRef, typename CodepointIterator>
     friend class grapheme_iterator;
+    friend class grapheme_view;
 
 public:
     grapheme(const std::u32string & codepoints);
 
+    grapheme(const grapheme & other);
+    grapheme(grapheme && other) noexcept;
+    grapheme& operator=(const grapheme & other);
+    grapheme& operator=(grapheme && other) noexcept;
+    ~grapheme();
+
     std::size_t codepoints_count() const;
 
     char32_t operator[](std::size_t i) const;
 
-    std::u32string::const_iterator codepoints_begin() const;
-    std::u32string::const_iterator codepoints_end() const;
+    const char32_t* codepoints_begin() const;
+    const char32_t* codepoints_end() const;
 
     grapheme get_compat() const;
     grapheme get_casefold() const;
@@ -30,8 +38,60 @@ public:
 private:
     // Special version of the ctor without checks, the boolean is a dummy parameter to distinguish between the two versions
     grapheme(const std::u32string & codepoints, bool);
+    grapheme(const char32_t * codepoints, std::size_t count, bool);
+
+    char32_t* data();
+    const char32_t* data() const;
+    void reserve(std::size_t capacity);
+    void push_back(char32_t codepoint);
+    void take(grapheme & other) noexcept;
+
+    // Most graphemes have a few codepoints: they are stored inline (in the same
+    // space as the heap pointer), only longer ones (emoji ZWJ sequences, stacked
+    // combining marks...) are stored on the heap.
+    static const std::size_t INLINE_CAPACITY = 6;
+
+    std::uint32_t m_size;
+    std::uint32_t m_capacity;
+    union
+    {
+        char32_t m_inline[INLINE_CAPACITY];
+        char32_t* m_heap;
+    };
+};
+
+/**
+ * Non-owning view of a grapheme stored in a UTF-8 buffer (as returned by grapheme_iterator):
+ * only the byte offsets of the grapheme are stored, its codepoints are decoded on access.
+ * The view is invalidated when the buffer is modified or destroyed.
+ */
+class grapheme_view
+{
+public:
+    grapheme_view(const char* data, std::size_t begin_offset, std::size_t end_offset);
+    grapheme_view(const std::string & str, std::size_t begin_offset, std::size_t end_offset);
 
-    std::u32string m_codepoints;
+    std::size_t begin_offset() const;
+    std::size_t end_offset() const;
+
+    const char* octets_begin() const;
+    const char* octets_end() const;
+    std::size_t octets_count() const;
+
+    std::size_t codepoints_count() const;
+
+    char32_t operator[](std::size_t i) const;
+
+    /**
+     * Copies the codepoints into a standalone grapheme.
+     */
+    grapheme to_grapheme() const;
+    operator grapheme() const;
+
+private:
+    const char* m_data;
+    std::size_t m_begin;
+    std::size_t m_end;
 };
 
 }
@@ -0,0 +1,72 @@
+#include "GraphemeBreak.hpp"
+
+#include <cstring>
+#include <map>
+
+namespace unicpp
+{
+
+// The constants are bound to references (by std::vector for instance), so they need a definition
+const std::size_t grapheme_break_table::CLASSES;
+const char32_t grapheme_break_table::CODEPOINTS;
+const std::size_t grapheme_break_table::BLOCK_BITS;
+const char32_t grapheme_break_table::BLOCK_MASK;
+const std::uint8_t grapheme_break_table::BREAK;
+const std::uint8_t grapheme_break_table::STATE_MASK;
+
+grapheme_break_table::grapheme_break_table() :
+    m_out_of_range_class(static_cast<std::uint8_t>(utf8proc_get_property(CODEPOINTS)->boundclass))
+{
+    const std::size_t block_size = std::size_t(1) << BLOCK_BITS;
+
+    // The blocks are deduplicated: most of them only contain Other (or unassigned) codepoints
+    std::map<std::vector<std::uint8_t>, std::uint16_t> known_blocks;
+    std::vector<char32_t> representatives(CLASSES, CODEPOINTS);
+    std::vector<std::uint8_t> block(block_size);
+
+    for(char32_t first = 0; first < CODEPOINTS; first += block_size)
+    {
+        for(std::size_t i = 0; i < block_size; ++i)
+        {
+            block[i] = static_cast<std::uint8_t>(utf8proc_get_property(first + i)->boundclass);
+            if(representatives[block[i]] == CODEPOINTS)
+                representatives[block[i]] = first + i;
+        }
+
+        auto inserted = known_blocks.emplace(block, static_cast<std::uint16_t>(known_blocks.size()));
+        if(inserted.second)
+            m_blocks.insert(m_blocks.end(), block.begin(), block.end());
+        m_stage1[first >> BLOCK_BITS] = inserted.first->second;
+    }
+
+    // The rules only depend on the classes: the transitions are computed by utf8proc itself,
+    // with a codepoint of each class. The classes without codepoints can never be looked up.
+    std::memset(m_transitions, 0, sizeof(m_transitions));
+    std::memset(m_start_transitions, 0, sizeof(m_start_transitions));
+
+    for(std::size_t next = 0; next < CLASSES; ++next)
+    {
+        if(representatives[next] == CODEPOINTS)
+            continue;
+
+        for(std::size_t previous = 0; previous < CLASSES; ++previous)
+        {
+            if(previous != UTF8PROC_BOUNDCLASS_START)
+            {
+                // The previous codepoint is not used once there is a state
+                utf8proc_int32_t state = static_cast<utf8proc_int32_t>(previous);
+                bool is_break = utf8proc_grapheme_break_stateful(representatives[next], representatives[next], &state);
+                m_transitions[previous][next] = static_cast<std::uint8_t>(state) | (is_break ? BREAK : 0);
+            }
+
+            if(representatives[previous] != CODEPOINTS)
+            {
+                utf8proc_int32_t state = UTF8PROC_BOUNDCLASS_START;
+                bool is_break = utf8proc_grapheme_break_stateful(representatives[previous], representatives[next], &state);
+                m_start_transitions[previous][next] = static_cast<std::uint8_t>(state) | (is_break ? BREAK : 0);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef UNICPP_GRAPHEMEBREAK_H
+#define UNICPP_GRAPHEMEBREAK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utf8proc/utf8proc.h"
+
+/**
+ * \file Contains the tables used to segment strings into graphemes. They give exactly the
+ * same boundaries and states as utf8proc_grapheme_break_stateful, but only need two loads
+ * per codepoint instead of two property lookups and the evaluation of the rules.
+ * Used internally by unicpp::string.
+ */
+
+namespace unicpp
+{
+
+class grapheme_break_table
+{
+public:
+    /**
+     * Returns the table, built from the utf8proc properties on the first call.
+     */
+    static const grapheme_break_table& get()
+    {
+        // Inline, as it is called for every grapheme
+        static const grapheme_break_table table;
+        return table;
+    }
+
+    /**
+     * Returns the grapheme break class of a codepoint (a utf8proc_boundclass_t).
+     */
+    std::uint8_t get_class(char32_t codepoint) const
+    {
+        if(codepoint >= CODEPOINTS)
+            return m_out_of_range_class;
+
+        return m_blocks[(static_cast<std::size_t>(m_stage1[codepoint >> BLOCK_BITS]) << BLOCK_BITS) | (codepoint & BLOCK_MASK)];
+    }
+
+    /**
+     * Same as utf8proc_grapheme_break_stateful(previous, next, &state).
+     * previous is only used at the beginning of the segmentation (when state is 0).
+     */
+    bool is_break(char32_t previous, char32_t next, utf8proc_int32_t& state) const
+    {
+        std::uint8_t next_class = get_class(next);
+        std::uint8_t transition = (state == UTF8PROC_BOUNDCLASS_START)
+            ? m_start_transitions[get_class(previous)][next_class]
+            : m_transitions[state][next_class];
+
+        state = transition & STATE_MASK;
+        return (transition & BREAK) != 0;
+    }
+
+private:
+    grapheme_break_table();
+
+    static const std::size_t CLASSES = UTF8PROC_BOUNDCLASS_E_BASE_GAZ + 1;
+    static const char32_t CODEPOINTS = 0x110000;
+    static const std::size_t BLOCK_BITS = 8;
+    static const char32_t BLOCK_MASK = (1 << BLOCK_BITS) - 1;
+
+    // A transition is the state after the next codepoint, plus BREAK if there is a boundary before it
+    static const std::uint8_t BREAK = 0x80;
+    static const std::uint8_t STATE_MASK = 0x1F;
+
+    // Two-stage trie: index of the block of classes of each 256 codepoints
+    std::uint16_t m_stage1[CODEPOINTS >> BLOCK_BITS];
+    std::vector<std::uint8_t> m_blocks;
+    std::uint8_t m_out_of_range_class;
+
+    // Indexed by the state and the class of the next codepoint
+    std::uint8_t m_transitions[CLASSES][CLASSES];
+
+    // Indexed by the classes of both codepoints, at the beginning of the segmentation
+    std::uint8_t m_start_transitions[CLASSES][CLASSES];
+};
+
+}
+
+#endif
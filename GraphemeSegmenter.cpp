@@ -0,0 +1,102 @@
+#include "GraphemeSegmenter.hpp"
+
+#include <cstring>
+
+#include "Utf8Tools.hpp"
+
+namespace unicpp
+{
+
+grapheme_segmenter::grapheme_segmenter() :
+    m_table(&grapheme_break_table::get())
+{
+    reset();
+}
+
+std::size_t grapheme_segmenter::feed(const char* data, std::size_t length, std::vector<std::uint64_t>& boundaries)
+{
+    // An empty chunk may come without any buffer
+    if(length == 0)
+        return 0;
+
+    const std::size_t previous_size = boundaries.size();
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = begin + length;
+    const unsigned char* it = begin;
+
+    const std::uint64_t chunk_offset = m_position;
+    m_position += length;
+
+    // Completes the sequence cut by the end of the previous chunk
+    if(m_pending_length > 0)
+    {
+        utf8_cut_sequence_result cut = complete_cut_sequence(m_pending, m_pending_length, begin, length);
+        if(cut.incomplete)
+            return 0;
+        if(cut.decoded.status != utf8_status::ok)
+            throw_utf8_error(cut.decoded, m_pending[0]);
+
+        segment(cut.decoded.codepoint, chunk_offset - m_pending_length, boundaries);
+        it += cut.chunk_octets;
+        m_pending_length = 0;
+    }
+
+    while(it != end)
+    {
+        const unsigned char* sequence = it;
+        utf8_decode_result result = decode_next(it, end);
+        if(result.status != utf8_status::ok)
+        {
+            // Only cut by the end of the chunk, it is completed by the next one
+            if(result.status == utf8_status::truncated_sequence && it == end)
+            {
+                m_pending_length = end - sequence;
+                std::memcpy(m_pending, sequence, m_pending_length);
+                break;
+            }
+
+            throw_utf8_error(result, *sequence);
+        }
+
+        segment(result.codepoint, chunk_offset + (sequence - begin), boundaries);
+    }
+
+    return boundaries.size() - previous_size;
+}
+
+std::size_t grapheme_segmenter::finish(std::vector<std::uint64_t>& boundaries)
+{
+    if(m_pending_length > 0)
+    {
+        unsigned char lead_octet = m_pending[0];
+        std::size_t length = m_pending_length;
+        reset();
+        throw_utf8_error(utf8_decode_result{utf8_status::truncated_sequence, 0, length}, lead_octet);
+    }
+
+    std::size_t appended = 0;
+    if(m_has_previous)
+    {
+        boundaries.push_back(m_position);
+        appended = 1;
+    }
+
+    reset();
+    return appended;
+}
+
+void grapheme_segmenter::reset()
+{
+    m_state = 0;
+    m_previous = 0;
+    m_has_previous = false;
+    m_pending_length = 0;
+    m_position = 0;
+}
+
+std::uint64_t grapheme_segmenter::position() const
+{
+    return m_position;
+}
+
+}
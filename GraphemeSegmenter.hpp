@@ -0,0 +1,82 @@
+#ifndef UNICPP_GRAPHEMESEGMENTER_H
+#define UNICPP_GRAPHEMESEGMENTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utf8proc/utf8proc.h"
+
+#include "GraphemeBreak.hpp"
+
+namespace unicpp
+{
+
+/**
+ * Incremental grapheme segmentation of a UTF-8 stream received in chunks of any size.
+ *
+ * The segmenter only keeps the segmentation state, the last codepoint and the octets of a
+ * sequence cut by the end of a chunk, so its memory does not depend on the length of the
+ * stream. The boundaries are the same as the ones of grapheme_iterator over the whole stream.
+ */
+class grapheme_segmenter
+{
+public:
+    grapheme_segmenter();
+
+    /**
+     * Segments the next chunk of the stream and appends to boundaries the offset (from the
+     * beginning of the stream) of the end of every grapheme completed by the chunk. Returns the
+     * number of offsets appended.
+     *
+     * A grapheme is only completed once the codepoint following it is known: the end of the
+     * last grapheme of the stream is reported by finish().
+     *
+     * Throws the exceptions of codepoint_iterator (with strict_decoding) if the stream is not
+     * valid UTF-8, the segmenter must then be reset() before being used again.
+     */
+    std::size_t feed(const char* data, std::size_t length, std::vector<std::uint64_t>& boundaries);
+
+    /**
+     * Ends the stream: appends the end of its last grapheme to boundaries (unless the stream
+     * is empty), resets the segmenter and returns the number of offsets appended.
+     * Throws bad_utf8_sequence_exception if the stream ends with an incomplete sequence.
+     */
+    std::size_t finish(std::vector<std::uint64_t>& boundaries);
+
+    /**
+     * Forgets the current stream.
+     */
+    void reset();
+
+    /**
+     * Returns the number of octets fed since the beginning of the stream.
+     */
+    std::uint64_t position() const;
+
+private:
+    void segment(char32_t codepoint, std::uint64_t offset, std::vector<std::uint64_t>& boundaries)
+    {
+        if(m_has_previous && m_table->is_break(m_previous, codepoint, m_state))
+            boundaries.push_back(offset);
+
+        m_previous = codepoint;
+        m_has_previous = true;
+    }
+
+    const grapheme_break_table* m_table;
+
+    utf8proc_int32_t m_state;
+    char32_t m_previous;
+    bool m_has_previous;
+
+    // Octets of the sequence cut by the end of the last chunk
+    unsigned char m_pending[4];
+    std::size_t m_pending_length;
+
+    std::uint64_t m_position;
+};
+
+}
+
+#endif
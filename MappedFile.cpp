@@ -0,0 +1,180 @@
+#include "MappedFile.hpp"
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define UNICPP_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace unicpp
+{
+
+namespace
+{
+
+[[noreturn]] void throw_system_error(const std::string& what_arg)
+{
+    throw std::system_error(errno, std::generic_category(), what_arg);
+}
+
+}
+
+mapped_file::mapped_file() :
+    m_data(nullptr),
+    m_size(0)
+{
+
+}
+
+#ifdef UNICPP_HAS_MMAP
+
+mapped_file::mapped_file(const std::string& path, access_pattern pattern) :
+    mapped_file()
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw_system_error("Cannot open " + path);
+
+    struct stat status;
+    if(::fstat(fd, &status) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        throw_system_error("Cannot read the size of " + path);
+    }
+
+    // Empty files cannot be mapped, there is nothing to map anyway
+    if(status.st_size > 0)
+    {
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        int error = errno;
+        ::close(fd); // The mapping keeps its own reference to the file
+        if(address == MAP_FAILED)
+        {
+            errno = error;
+            throw_system_error("Cannot map " + path);
+        }
+
+        m_data = static_cast<const char*>(address);
+        m_size = static_cast<std::size_t>(status.st_size);
+        advise(pattern);
+    }
+    else
+        ::close(fd);
+}
+
+void mapped_file::advise(access_pattern pattern)
+{
+    if(m_size == 0)
+        return;
+
+    int advice = MADV_NORMAL;
+    if(pattern == access_pattern::sequential)
+        advice = MADV_SEQUENTIAL;
+    else if(pattern == access_pattern::random)
+        advice = MADV_RANDOM;
+
+    // Only a hint: the mapping works the same if it is ignored
+    ::madvise(const_cast<char*>(m_data), m_size, advice);
+}
+
+void mapped_file::close()
+{
+    if(m_size > 0)
+        ::munmap(const_cast<char*>(m_data), m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#else
+
+mapped_file::mapped_file(const std::string& path, access_pattern) :
+    mapped_file()
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        throw_system_error("Cannot open " + path);
+
+    m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if(file.bad())
+        throw_system_error("Cannot read " + path);
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+void mapped_file::advise(access_pattern)
+{
+
+}
+
+void mapped_file::close()
+{
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#endif
+
+mapped_file::mapped_file(mapped_file&& other) :
+    m_data(other.m_data),
+    m_size(other.m_size),
+    m_buffer(std::move(other.m_buffer))
+{
+    // A short buffer is stored in the std::string object itself, so its data moves with it
+    if(!m_buffer.empty())
+        m_data = m_buffer.data();
+
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other)
+{
+    if(this != &other)
+    {
+        close();
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        m_buffer = std::move(other.m_buffer);
+        if(!m_buffer.empty())
+            m_data = m_buffer.data();
+    }
+
+    return *this;
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+const char* mapped_file::data() const
+{
+    return m_data;
+}
+
+std::size_t mapped_file::size() const
+{
+    return m_size;
+}
+
+string_view mapped_file::view() const
+{
+    return string_view(m_data, m_size);
+}
+
+}
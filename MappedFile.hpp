@@ -0,0 +1,77 @@
+#ifndef UNICPP_MAPPEDFILE_H
+#define UNICPP_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+#include "StringView.hpp"
+
+namespace unicpp
+{
+
+/**
+ * Read-only memory mapping of a whole file, so that it can be validated, counted, segmented
+ * or transcoded through a string_view without being read into memory first: the pages are
+ * only loaded when they are accessed, and can be dropped again by the system.
+ *
+ * The content is undefined if the file is modified while it is mapped. On the platforms
+ * without mmap, the file is read into memory instead.
+ */
+class mapped_file
+{
+public:
+    /**
+     * How the content is going to be accessed, passed on to the system (with madvise) to
+     * tune the read-ahead.
+     */
+    enum class access_pattern
+    {
+        normal,
+        sequential, ///< Scans: is_valid(), the counts, the iterations and the conversions
+        random      ///< Seeks to a few parts of the file
+    };
+
+    mapped_file();
+
+    /**
+     * Maps the file at path. Throws std::system_error if it cannot be opened or mapped.
+     */
+    explicit mapped_file(const std::string& path, access_pattern pattern = access_pattern::sequential);
+
+    mapped_file(const mapped_file& other) = delete;
+    mapped_file(mapped_file&& other);
+
+    mapped_file& operator=(const mapped_file& other) = delete;
+    mapped_file& operator=(mapped_file&& other);
+
+    ~mapped_file();
+
+    /**
+     * Changes the expected access pattern of the content.
+     */
+    void advise(access_pattern pattern);
+
+    const char* data() const;
+    std::size_t size() const;
+
+    /**
+     * Returns a view of the whole content, valid until the file is unmapped.
+     */
+    string_view view() const;
+
+    /**
+     * Unmaps the file, which becomes empty.
+     */
+    void close();
+
+private:
+    const char* m_data;
+    std::size_t m_size;
+
+    // Content of the file when it could not be mapped
+    std::string m_buffer;
+};
+
+}
+
+#endif
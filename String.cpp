@@ -1,48 +1,167 @@
 #include "String.hpp"
 
+#include "StringView.hpp"
+#include "Utf8Simd.hpp"
+#include "Utf8Transcode.hpp"
+#include "WideEncoding.hpp"
+
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <type_traits>
 
 namespace unicpp
 {
 
-
 string::string() :
-    m_content()
+    m_content(),
+    m_codepoints_count(0),
+    m_graphemes_count(0),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
 
 }
 
 string::string(const char* str) :
-    m_content(str)
+    m_content(str),
+    m_codepoints_count(unknown_count),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
 
 }
 
 string::string(const char* str, size_t size) :
-    m_content(str, size)
+    m_content(str, size),
+    m_codepoints_count(unknown_count),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
 
 }
 
-string::string(std::size_t count, char32_t character)
+string::string(const string_view& view) :
+    string(view.octets_begin(), view.octets_count())
 {
-    std::u32string utf32str(count, character);
-    utf32_to_utf8(utf32str.begin(), utf32str.end(), std::back_inserter(m_content));
+
 }
 
-string::string(const std::u16string& utf16str)
+string::string(std::size_t count, char32_t character) :
+    m_codepoints_count(count),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
-    utf16_to_utf8(utf16str.begin(), utf16str.end(), std::back_inserter(m_content));
+    if(count == 0)
+        return;
+
+    // The character is encoded once, then repeated in the presized content
+    char sequence[4];
+    std::size_t length = codepoint_to_utf8(character, sequence) - sequence;
+
+    m_content.reserve(count * length);
+    for(std::size_t i = 0; i < count; ++i)
+        m_content.append(sequence, length);
 }
 
-string::string(const std::u32string& utf32str)
+string::string(const std::u16string& utf16str) :
+    m_codepoints_count(unknown_count),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
-    utf32_to_utf8(utf32str.begin(), utf32str.end(), std::back_inserter(m_content));
+    const char16_t* begin = utf16str.data();
+    const char16_t* end = begin + utf16str.size();
+
+    m_content.resize(utf8_length_from_utf16(begin, end));
+    char* output_end = transcode_utf16_to_utf8(begin, end, &m_content[0]);
+    m_content.resize(output_end - &m_content[0]);
 }
 
-std::string& string::std_str()
+string::string(const std::u32string& utf32str) :
+    m_codepoints_count(utf32str.size()),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
 {
-    return m_content;
+    const char32_t* begin = utf32str.data();
+    const char32_t* end = begin + utf32str.size();
+
+    m_content.resize(utf8_length_from_utf32(begin, end));
+    char* output_end = transcode_utf32_to_utf8(begin, end, &m_content[0]);
+    m_content.resize(output_end - &m_content[0]);
+}
+
+string::string(const std::wstring& wstr) :
+    m_codepoints_count(sizeof(wchar_t) == 4 ? wstr.size() : unknown_count),
+    m_graphemes_count(unknown_count),
+    m_has_codepoint_index(false),
+    m_has_grapheme_index(false)
+{
+    const wchar_t* begin = wstr.data();
+    const wchar_t* end = begin + wstr.size();
+
+    m_content.resize(platform_wide_encoding::utf8_length(begin, end));
+    char* output_end = transcode_wide_to_utf8(begin, end, &m_content[0]);
+    m_content.resize(output_end - &m_content[0]);
+}
+
+string::string(const string& other) :
+    m_content(other.m_content),
+    m_codepoints_count(other.m_codepoints_count.load(std::memory_order_relaxed)),
+    m_graphemes_count(other.m_graphemes_count.load(std::memory_order_relaxed)),
+    m_codepoint_index(other.m_codepoint_index),
+    m_has_codepoint_index(other.m_has_codepoint_index),
+    m_grapheme_index(other.m_grapheme_index),
+    m_has_grapheme_index(other.m_has_grapheme_index)
+{
+
+}
+
+string::string(string&& other) :
+    m_content(std::move(other.m_content)),
+    m_codepoints_count(other.m_codepoints_count.load(std::memory_order_relaxed)),
+    m_graphemes_count(other.m_graphemes_count.load(std::memory_order_relaxed)),
+    m_codepoint_index(std::move(other.m_codepoint_index)),
+    m_has_codepoint_index(other.m_has_codepoint_index),
+    m_grapheme_index(std::move(other.m_grapheme_index)),
+    m_has_grapheme_index(other.m_has_grapheme_index)
+{
+    // The content of a moved-from std::string is unspecified
+    other.invalidate_caches();
+}
+
+string& string::operator=(const string& other)
+{
+    m_content = other.m_content;
+    m_codepoints_count.store(other.m_codepoints_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_graphemes_count.store(other.m_graphemes_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_codepoint_index = other.m_codepoint_index;
+    m_has_codepoint_index = other.m_has_codepoint_index;
+    m_grapheme_index = other.m_grapheme_index;
+    m_has_grapheme_index = other.m_has_grapheme_index;
+
+    return *this;
+}
+
+string& string::operator=(string&& other)
+{
+    if(this != &other)
+    {
+        m_content = std::move(other.m_content);
+        m_codepoints_count.store(other.m_codepoints_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_graphemes_count.store(other.m_graphemes_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_codepoint_index = std::move(other.m_codepoint_index);
+        m_has_codepoint_index = other.m_has_codepoint_index;
+        m_grapheme_index = std::move(other.m_grapheme_index);
+        m_has_grapheme_index = other.m_has_grapheme_index;
+        other.invalidate_caches();
+    }
+
+    return *this;
 }
 
 const std::string& string::std_str() const
@@ -50,17 +169,15 @@ const std::string& string::std_str() const
     return m_content;
 }
 
-std::wstring string::w_str()
+std::wstring string::w_str() const
 {
-    std::wstring result;
-
-    return result;
+    return string_view(m_content.data(), m_content.size()).w_str();
 }
 
 std::u16string string::utf16_str() const
 {
     std::u16string result;
-    utf8_to_utf16(m_content.begin(), m_content.end(), std::back_inserter(result));
+    utf16_into(result);
 
     return result;
 }
@@ -68,14 +185,445 @@ std::u16string string::utf16_str() const
 std::u32string string::utf32_str() const
 {
     std::u32string result;
-    utf8_to_utf32(m_content.begin(), m_content.end(), std::back_inserter(result));
+    utf32_into(result);
+
+    return result;
+}
+
+std::u16string string::utf16_str(lossy_decoding) const
+{
+    std::u16string result;
+    utf16_into(result, lossy_decoding());
+
+    return result;
+}
+
+std::u32string string::utf32_str(lossy_decoding) const
+{
+    std::u32string result;
+    utf32_into(result, lossy_decoding());
 
     return result;
 }
 
+void string::utf16_into(std::u16string& buffer) const
+{
+    string_view(m_content.data(), m_content.size()).utf16_into(buffer);
+}
+
+void string::utf32_into(std::u32string& buffer) const
+{
+    string_view(m_content.data(), m_content.size()).utf32_into(buffer);
+}
+
+void string::utf16_into(std::u16string& buffer, lossy_decoding) const
+{
+    string_view(m_content.data(), m_content.size()).utf16_into(buffer, lossy_decoding());
+}
+
+void string::utf32_into(std::u32string& buffer, lossy_decoding) const
+{
+    string_view(m_content.data(), m_content.size()).utf32_into(buffer, lossy_decoding());
+}
+
 bool string::is_valid() const
 {
-    return is_valid_utf8(m_content.begin(), m_content.end());
+    return validate_utf8(m_content.data(), m_content.size());
+}
+
+namespace
+{
+
+/**
+ * Appends data to output, replacing the malformed sequences.
+ * first_invalid is the offset of the first invalid sequence (see find_invalid_utf8).
+ */
+void append_sanitized(const char* data, std::size_t length, std::size_t first_invalid, std::string& output)
+{
+    const char* it = data;
+    const char* end = data + length;
+    std::size_t valid_length = first_invalid;
+    while(true)
+    {
+        output.append(it, valid_length);
+        it += valid_length;
+        if(it == end)
+            break;
+
+        decode_next_lossy(it, end); // Skips the maximal subpart of the invalid sequence
+        output.append("\xEF\xBF\xBD"); // REPLACEMENT_CHARACTER
+
+        valid_length = find_invalid_utf8(it, end - it);
+    }
+}
+
+}
+
+string& string::sanitize()
+{
+    std::size_t first_invalid = find_invalid_utf8(m_content.data(), m_content.size());
+    if(first_invalid == m_content.size())
+        return *this;
+
+    std::string result;
+    result.reserve(m_content.size());
+    append_sanitized(m_content.data(), m_content.size(), first_invalid, result);
+    m_content.swap(result);
+    invalidate_caches();
+
+    return *this;
+}
+
+string string::sanitized() const
+{
+    string result;
+    result.m_content.reserve(m_content.size());
+    append_sanitized(m_content.data(), m_content.size(), find_invalid_utf8(m_content.data(), m_content.size()), result.m_content);
+    result.invalidate_caches();
+
+    return result;
+}
+
+std::size_t string::codepoints_count() const
+{
+    std::size_t count = m_codepoints_count.load(std::memory_order_relaxed);
+    if(count != unknown_count)
+        return count;
+
+    // Counting the leading octets is only correct for valid strings
+    check_valid();
+
+    count = count_utf8_codepoints(m_content.data(), m_content.size());
+    m_codepoints_count.store(count, std::memory_order_relaxed);
+
+    return count;
+}
+
+std::size_t string::graphemes_count() const
+{
+    std::size_t count = m_graphemes_count.load(std::memory_order_relaxed);
+    if(count != unknown_count)
+        return count;
+
+    count = std::distance(gbegin(), gend());
+    m_graphemes_count.store(count, std::memory_order_relaxed);
+
+    return count;
+}
+
+void string::build_codepoint_index()
+{
+    check_valid();
+
+    m_codepoint_index.clear();
+    std::size_t count = index_utf8_codepoints(m_content.data(), m_content.size(), 0, CODEPOINT_INDEX_STRIDE, m_codepoint_index);
+    m_codepoints_count.store(count, std::memory_order_relaxed);
+    m_has_codepoint_index = true;
+}
+
+bool string::has_codepoint_index() const
+{
+    return m_has_codepoint_index;
+}
+
+std::size_t string::codepoint_offset(std::size_t n) const
+{
+    // Also checks that the string is valid, the codepoints can then be skipped without decoding them
+    std::size_t count = codepoints_count();
+    if(n > count)
+        throw std::out_of_range("unicpp::string: codepoint index out of range");
+    if(n == count)
+        return m_content.size();
+
+    std::size_t offset = 0;
+    std::size_t current = 0;
+    if(m_has_codepoint_index)
+    {
+        offset = m_codepoint_index[n / CODEPOINT_INDEX_STRIDE];
+        current = n - n % CODEPOINT_INDEX_STRIDE;
+    }
+
+    for(; current < n; ++current)
+    {
+        do
+            ++offset;
+        while(is_trail_octet(m_content[offset]));
+    }
+
+    return offset;
+}
+
+std::size_t string::codepoint_index(std::size_t offset) const
+{
+    codepoints_count(); // Checks that the string is valid
+    offset = std::min(offset, m_content.size());
+
+    std::size_t position = 0;
+    std::size_t current = 0;
+    if(m_has_codepoint_index && !m_codepoint_index.empty())
+    {
+        // Last indexed codepoint before the offset (the first one is always at offset 0)
+        auto it = std::upper_bound(m_codepoint_index.begin(), m_codepoint_index.end(), offset) - 1;
+        position = *it;
+        current = (it - m_codepoint_index.begin()) * CODEPOINT_INDEX_STRIDE;
+    }
+
+    for(; position < offset; ++position)
+    {
+        if(!is_trail_octet(m_content[position]))
+            ++current;
+    }
+
+    return current;
+}
+
+char32_t string::at(std::size_t n) const
+{
+    if(n >= codepoints_count())
+        throw std::out_of_range("unicpp::string: codepoint index out of range");
+
+    const char* it = m_content.data() + codepoint_offset(n);
+    return decode_next_trusted(it, m_content.data() + m_content.size());
+}
+
+string::const_iterator string::nth(std::size_t n) const
+{
+    return const_iterator(m_content, m_content.begin() + codepoint_offset(n));
+}
+
+string string::substr(std::size_t pos, std::size_t count) const
+{
+    std::size_t begin = codepoint_offset(pos);
+    std::size_t end_index = (count > codepoints_count() - pos) ? codepoints_count() : pos + count;
+    std::size_t end = codepoint_offset(end_index);
+
+    string result(m_content.data() + begin, end - begin);
+    result.m_codepoints_count.store(end_index - pos, std::memory_order_relaxed);
+
+    return result;
+}
+
+void string::build_grapheme_index()
+{
+    check_valid();
+
+    m_grapheme_index.clear();
+    repair_grapheme_index(0, m_content.size(), m_content.size());
+}
+
+bool string::has_grapheme_index() const
+{
+    return m_has_grapheme_index;
+}
+
+string::const_grapheme_iterator string::nth_grapheme(std::size_t n) const
+{
+    if(n > graphemes_count())
+        throw std::out_of_range("unicpp::string: grapheme index out of range");
+
+    grapheme_index_entry start{0, 0, 0};
+    if(m_has_grapheme_index && !m_grapheme_index.empty())
+    {
+        // Last indexed grapheme before the nth one
+        start = *(std::upper_bound(m_grapheme_index.begin(), m_grapheme_index.end(), n,
+            [](std::size_t value, const grapheme_index_entry& entry) { return value < entry.grapheme; }) - 1);
+    }
+
+    const_grapheme_iterator it(*this, const_iterator(m_content, m_content.begin() + start.offset), start.state);
+    for(std::size_t grapheme = start.grapheme; grapheme < n; ++grapheme)
+        ++it;
+
+    return it;
+}
+
+std::size_t string::grapheme_index(std::size_t offset) const
+{
+    offset = std::min(offset, m_content.size());
+
+    grapheme_index_entry start{0, 0, 0};
+    if(m_has_grapheme_index && !m_grapheme_index.empty())
+    {
+        start = *(std::upper_bound(m_grapheme_index.begin(), m_grapheme_index.end(), offset,
+            [](std::size_t value, const grapheme_index_entry& entry) { return value < entry.offset; }) - 1);
+    }
+
+    const_grapheme_iterator it(*this, const_iterator(m_content, m_content.begin() + start.offset), start.state);
+    std::size_t grapheme = start.grapheme;
+    for(; grapheme_offset(it) < offset; ++it)
+        ++grapheme;
+
+    return grapheme;
+}
+
+string& string::append(const string& other)
+{
+    std::size_t old_size = m_content.size();
+    std::size_t old_count = m_codepoints_count.load(std::memory_order_relaxed);
+    m_content += other.m_content;
+
+    // Works on the copy in this string, other may be this string
+    const char* appended = m_content.data() + old_size;
+    std::size_t appended_size = m_content.size() - old_size;
+
+    if(!validate_utf8(appended, appended_size))
+    {
+        invalidate_caches();
+        return *this;
+    }
+
+    // The indexes imply that this string was valid, they are patched with the appended octets only
+    if(m_has_codepoint_index)
+        reindex_codepoints(old_count, old_size);
+    else if(old_count != unknown_count)
+        m_codepoints_count.store(old_count + count_utf8_codepoints(appended, appended_size), std::memory_order_relaxed);
+
+    if(m_has_grapheme_index)
+        repair_grapheme_index(old_size, old_size, m_content.size());
+    else
+        m_graphemes_count.store(unknown_count, std::memory_order_relaxed);
+
+    return *this;
+}
+
+string& string::replace(std::size_t pos, std::size_t count, const string& replacement)
+{
+    // Nothing is modified if one of the strings is not valid
+    std::size_t inserted_count = replacement.codepoints_count();
+    std::size_t inserted_size = replacement.m_content.size();
+    std::size_t old_count = codepoints_count();
+
+    std::size_t begin = codepoint_offset(pos);
+    std::size_t end_index = (count > old_count - pos) ? old_count : pos + count;
+    std::size_t end = codepoint_offset(end_index);
+
+    m_content.replace(begin, end - begin, replacement.m_content);
+
+    if(m_has_codepoint_index)
+        reindex_codepoints(pos, begin);
+    else
+        m_codepoints_count.store(old_count - (end_index - pos) + inserted_count, std::memory_order_relaxed);
+
+    if(m_has_grapheme_index)
+        repair_grapheme_index(begin, end, begin + inserted_size);
+    else
+        m_graphemes_count.store(unknown_count, std::memory_order_relaxed);
+
+    return *this;
+}
+
+void string::invalidate_caches()
+{
+    m_codepoints_count.store(unknown_count, std::memory_order_relaxed);
+    m_graphemes_count.store(unknown_count, std::memory_order_relaxed);
+    m_codepoint_index.clear();
+    m_has_codepoint_index = false;
+    m_grapheme_index.clear();
+    m_has_grapheme_index = false;
+}
+
+void string::reindex_codepoints(std::size_t pos, std::size_t offset)
+{
+    // The entries of the codepoints before pos are still right
+    std::size_t kept = (pos + CODEPOINT_INDEX_STRIDE - 1) / CODEPOINT_INDEX_STRIDE;
+    m_codepoint_index.resize(kept);
+
+    std::size_t first = kept * CODEPOINT_INDEX_STRIDE - pos;
+    std::size_t count = pos + index_utf8_codepoints(m_content.data() + offset, m_content.size() - offset,
+                                                    first, CODEPOINT_INDEX_STRIDE, m_codepoint_index);
+    for(std::size_t i = kept; i < m_codepoint_index.size(); ++i)
+        m_codepoint_index[i] += offset;
+
+    m_codepoints_count.store(count, std::memory_order_relaxed);
+}
+
+void string::repair_grapheme_index(std::size_t begin, std::size_t old_end, std::size_t new_end)
+{
+    auto offset_less = [](const grapheme_index_entry& entry, std::size_t value) { return entry.offset < value; };
+
+    // The boundaries before begin (and the segmentation states there) did not change
+    auto first_modified = std::lower_bound(m_grapheme_index.begin(), m_grapheme_index.end(), begin, offset_less);
+    auto old = std::lower_bound(first_modified, m_grapheme_index.end(), old_end, offset_less);
+
+    grapheme_index_entry start = (first_modified == m_grapheme_index.begin()) ? grapheme_index_entry{0, 0, 0} : *(first_modified - 1);
+    const_grapheme_iterator it(*this, const_iterator(m_content, m_content.begin() + start.offset), start.state);
+    const_grapheme_iterator end = gend();
+
+    std::vector<grapheme_index_entry> repaired;
+    if(first_modified == m_grapheme_index.begin() && it != end)
+        repaired.push_back(start);
+
+    // Wraps around when octets were removed, the sums are still right
+    const std::size_t shift = new_end - old_end;
+
+    std::size_t grapheme = start.grapheme;
+    std::size_t since_entry = 0;
+    bool synchronized = false;
+    while(it != end)
+    {
+        ++it;
+        ++grapheme;
+        ++since_entry;
+
+        std::size_t offset = grapheme_offset(it);
+        if(offset >= new_end)
+        {
+            while(old != m_grapheme_index.end() && old->offset + shift < offset)
+                ++old;
+
+            // Same boundary with the same state: the rest of the segmentation did not change
+            if(old != m_grapheme_index.end() && old->offset + shift == offset && old->state == it.state)
+            {
+                synchronized = true;
+                break;
+            }
+        }
+
+        if(since_entry == GRAPHEME_INDEX_STRIDE && it != end)
+        {
+            repaired.push_back(grapheme_index_entry{offset, grapheme, it.state});
+            since_entry = 0;
+        }
+    }
+
+    if(synchronized)
+    {
+        const std::size_t grapheme_shift = grapheme - old->grapheme;
+        for(auto entry = old; entry != m_grapheme_index.end(); ++entry)
+        {
+            entry->offset += shift;
+            entry->grapheme += grapheme_shift;
+        }
+
+        m_graphemes_count.store(m_graphemes_count.load(std::memory_order_relaxed) + grapheme_shift, std::memory_order_relaxed);
+    }
+    else
+    {
+        old = m_grapheme_index.end();
+        m_graphemes_count.store(grapheme, std::memory_order_relaxed);
+    }
+
+    auto first_repaired = m_grapheme_index.erase(first_modified, old);
+    m_grapheme_index.insert(first_repaired, repaired.begin(), repaired.end());
+    m_has_grapheme_index = true;
+}
+
+std::size_t string::grapheme_offset(const const_grapheme_iterator& it) const
+{
+    return std::distance(m_content.cbegin(), it.codepoint_it.internal_it);
+}
+
+void string::check_valid() const
+{
+    const char* data = m_content.data();
+    const char* end = data + m_content.size();
+
+    std::size_t invalid = find_invalid_utf8(data, m_content.size());
+    if(invalid == m_content.size())
+        return;
+
+    // Throws the same error as the iterators
+    const char* it = data + invalid;
+    throw_utf8_error(decode_next(it, end), static_cast<unsigned char>(data[invalid]));
 }
 
 string::const_iterator string::begin() const
@@ -138,6 +686,26 @@ string::reverse_iterator string::rend()
     return std::reverse_iterator<string::iterator>(end());
 }
 
+string::const_lossy_iterator string::cbegin(lossy_decoding) const
+{
+    return const_lossy_iterator(m_content, m_content.begin());
+}
+
+string::const_lossy_iterator string::cend(lossy_decoding) const
+{
+    return const_lossy_iterator(m_content, m_content.end());
+}
+
+string::const_trusted_iterator string::cbegin(trusted_decoding) const
+{
+    return const_trusted_iterator(m_content, m_content.begin());
+}
+
+string::const_trusted_iterator string::cend(trusted_decoding) const
+{
+    return const_trusted_iterator(m_content, m_content.end());
+}
+
 string::const_grapheme_iterator string::gbegin() const
 {
     return const_grapheme_iterator(*this, cbegin());
@@ -1,69 +1,137 @@
 #ifndef UNICPP_STRING_H
 #define UNICPP_STRING_H
 
+#include <atomic>
 #include <iterator>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "utf8proc/utf8proc.h"
 
 #include "Grapheme.hpp"
+#include "GraphemeBreak.hpp"
 #include "Utf8Tools.hpp"
 
 namespace unicpp
 {
 
 class string;
+class string_view;
+
+/**
+ * Contiguous UTF-8 octets, with the part of the interface of std::string used by the
+ * iterators. The iterators of string_view store the range itself instead of a pointer to
+ * it (see string_handle), so that they stay valid as long as the octets and not only as
+ * long as the view.
+ */
+class octet_range
+{
+public:
+    octet_range() : m_begin(nullptr), m_end(nullptr) {}
+    octet_range(const char* begin, const char* end) : m_begin(begin), m_end(end) {}
+
+    const char* begin() const { return m_begin; }
+    const char* end() const { return m_end; }
+    const char* data() const { return m_begin; }
+    std::size_t size() const { return m_end - m_begin; }
+
+private:
+    const char* m_begin;
+    const char* m_end;
+};
+
+/**
+ * How the iterators refer to the string they browse: through a pointer, or by value for
+ * an octet_range.
+ */
+template<typename StringRef>
+struct string_handle
+{
+    using type = typename std::remove_reference<StringRef>::type*;
+
+    static type make(StringRef str) { return &str; }
+    static StringRef get(type handle) { return *handle; }
+};
+
+template<>
+struct string_handle<const octet_range&>
+{
+    using type = octet_range;
+
+    static type make(const octet_range& range) { return range; }
+    static const octet_range& get(const type& handle) { return handle; }
+};
 
-template<typename StringRef, typename InternalIterator>
+/**
+ * Bidirectional iterator over the codepoints of a string.
+ *
+ * The codepoint under the iterator is decoded (and validated) once, when the iterator
+ * is moved, and cached with the length of its sequence: dereferencing is a simple load
+ * and incrementing only has to skip the cached length. Errors are reported (with
+ * strict_decoding) when the iterator is dereferenced or incremented.
+ */
+template<typename StringRef, typename InternalIterator, typename DecodingPolicy = strict_decoding>
 class codepoint_iterator : public std::iterator<std::bidirectional_iterator_tag, char32_t, std::ptrdiff_t, char32_t*, char32_t>
 {
     friend class string;
+    friend class string_view;
 
 public:
-    using iterator_type = codepoint_iterator<StringRef, InternalIterator>;
+    using iterator_type = codepoint_iterator<StringRef, InternalIterator, DecodingPolicy>;
 
-    codepoint_iterator() {}
+    codepoint_iterator() :
+        internal_string(),
+        internal_it(),
+        current{utf8_status::end_of_range, 0, 0}
+    {
+
+    }
 
 private:
     codepoint_iterator(StringRef str, InternalIterator it) :
-        internal_string(str),
+        internal_string(string_handle<StringRef>::make(str)),
         internal_it(it)
     {
-
+        decode();
     }
 
 public:
     template<typename S, typename I>
-    codepoint_iterator(const codepoint_iterator<S, I>& other) :
+    codepoint_iterator(const codepoint_iterator<S, I, DecodingPolicy>& other) :
         internal_string(other.internal_string),
-        internal_it(other.internal_it)
+        internal_it(other.internal_it),
+        current(other.current)
     {
 
     }
 
     iterator_type& operator++()
     {
-        iterate_next(internal_it, internal_string.end());
+        check();
+        std::advance(internal_it, current.length);
+        decode();
         return *this;
     }
 
     iterator_type operator++(int)
     {
         iterator_type tmp(*this);
-        iterate_next(internal_it, internal_string.end());
+        operator++();
         return tmp;
     }
 
     iterator_type& operator--()
     {
-        iterate_previous(internal_it, internal_string.begin());
+        DecodingPolicy::previous(internal_it, internal_str().begin());
+        decode();
         return *this;
     }
 
     iterator_type operator--(int)
     {
         iterator_type tmp(*this);
-        iterate_previous(internal_it, internal_string.begin());
+        operator--();
         return tmp;
     }
 
@@ -79,29 +147,75 @@ public:
 
     char32_t operator*()
     {
-        auto tmp = InternalIterator(internal_it);
-        return iterate_next(tmp, internal_string.end());
+        check();
+        return current.codepoint;
     }
 
-    StringRef internal_string;
+    /**
+     * Returns the number of octets of the current codepoint sequence.
+     */
+    std::size_t sequence_length()
+    {
+        check();
+        return current.length;
+    }
+
+    /**
+     * Returns the string browsed by the iterator.
+     */
+    StringRef internal_str() const
+    {
+        return string_handle<StringRef>::get(internal_string);
+    }
+
+    // Stored as a pointer (or a range) to keep the iterator assignable
+    typename string_handle<StringRef>::type internal_string;
     InternalIterator internal_it;
+
+private:
+    template<typename S, typename I, typename D>
+    friend class codepoint_iterator;
+
+    void decode()
+    {
+        auto tmp = InternalIterator(internal_it);
+        current = DecodingPolicy::try_next(tmp, internal_str().end());
+    }
+
+    void check()
+    {
+        if(current.status != utf8_status::ok)
+            throw_utf8_error(current, (current.status == utf8_status::end_of_range) ? 0 : *internal_it);
+    }
+
+    utf8_decode_result current;
 };
 
+/**
+ * Forward iterator over the graphemes of a string.
+ *
+ * The end of the grapheme under the iterator is searched once (the first time the
+ * iterator is dereferenced or incremented) and dereferencing returns a grapheme_view
+ * over the string, so iterating does not allocate.
+ */
 template<typename StringRef, typename CodepointIterator>
-class grapheme_iterator : public std::iterator<std::forward_iterator_tag, grapheme, std::ptrdiff_t, grapheme, grapheme>
+class grapheme_iterator : public std::iterator<std::forward_iterator_tag, grapheme_view, std::ptrdiff_t, grapheme_view, grapheme_view>
 {
     friend class string;
+    friend class string_view;
 
 public:
     using iterator_type = grapheme_iterator<StringRef, CodepointIterator>;
 
-    grapheme_iterator() : state(0) {}
+    grapheme_iterator() : internal_string(), state(0), cluster_end_found(false) {}
 
 private:
-    grapheme_iterator(StringRef str, CodepointIterator it) :
-        internal_string(str),
+    grapheme_iterator(StringRef str, CodepointIterator it, utf8proc_int32_t state = 0) :
+        internal_string(string_handle<StringRef>::make(str)),
         codepoint_it(it),
-        state(0)
+        cluster_end(it),
+        state(state),
+        cluster_end_found(false)
     {
 
     }
@@ -111,32 +225,18 @@ public:
     grapheme_iterator(const grapheme_iterator<S, I>& other) :
         internal_string(other.internal_string),
         codepoint_it(other.codepoint_it),
-        state(other.state)
+        cluster_end(other.cluster_end),
+        state(other.state),
+        cluster_end_found(other.cluster_end_found)
     {
 
     }
 
     iterator_type& operator++()
     {
-        char32_t codepoint = *codepoint_it;
-        ++codepoint_it;
-
-        if(codepoint_it == internal_string.cend())
-            return *this;
-
-        char32_t next_codepoint = *codepoint_it;
-        bool has_entered_loop = false;
-        while(!utf8proc_grapheme_break_stateful(codepoint, next_codepoint, &state))
-        {
-            has_entered_loop = true;
-            codepoint = next_codepoint;
-
-            ++codepoint_it;
-            if(codepoint_it == internal_string.cend())
-                break;
-
-            next_codepoint = *codepoint_it;
-        }
+        find_cluster_end();
+        codepoint_it = cluster_end;
+        cluster_end_found = false;
 
         return *this;
     }
@@ -158,37 +258,54 @@ public:
         return codepoint_it != rhs.codepoint_it;
     }
 
-    grapheme operator*()
+    grapheme_view operator*()
     {
-        auto tmp = CodepointIterator(codepoint_it);
+        find_cluster_end();
+
+        const auto& octets = codepoint_it.internal_str();
+        auto octets_begin = octets.begin();
+        return grapheme_view(
+            octets.data(),
+            std::distance(octets_begin, codepoint_it.internal_it),
+            std::distance(octets_begin, cluster_end.internal_it));
+    }
 
-        char32_t codepoint = *tmp;
-        ++tmp;
+    typename string_handle<StringRef>::type internal_string;
+    CodepointIterator codepoint_it;
 
-        std::u32string grapheme_str{codepoint};
+private:
+    template<typename S, typename I>
+    friend class grapheme_iterator;
 
-        if(tmp == internal_string.cend())
-            return grapheme(grapheme_str, false);
+    void find_cluster_end()
+    {
+        if(cluster_end_found)
+            return;
 
-        char32_t next_codepoint = *tmp;
-        while(!utf8proc_grapheme_break_stateful(codepoint, next_codepoint, &state))
-        {
-            codepoint = next_codepoint;
-            grapheme_str.push_back(codepoint);
+        cluster_end_found = true;
+        cluster_end = codepoint_it;
+
+        auto end = codepoint_it.internal_str().end();
+        if(cluster_end.internal_it == end)
+            return;
 
-            ++tmp;
-            if(tmp == internal_string.cend())
+        const grapheme_break_table& table = grapheme_break_table::get();
+        char32_t codepoint = *cluster_end;
+        ++cluster_end;
+        while(cluster_end.internal_it != end)
+        {
+            char32_t next_codepoint = *cluster_end;
+            if(table.is_break(codepoint, next_codepoint, state))
                 break;
 
-            next_codepoint = *tmp;
+            codepoint = next_codepoint;
+            ++cluster_end;
         }
-
-        return grapheme(grapheme_str, false);
     }
 
-    StringRef internal_string;
-    CodepointIterator codepoint_it;
+    CodepointIterator cluster_end;
     utf8proc_int32_t state;
+    bool cluster_end_found;
 };
 
 class as_codepoints
@@ -206,6 +323,21 @@ public:
     static offset_type get_byte_distance(const string & str, const const_iterator & b, const const_iterator & it);
 
     static offset_type get_codepoint_distance(const string & str, const const_iterator & b, const const_iterator & it);
+
+    /**
+     * Same as above, for the buffers browsed through a string_view.
+     */
+    using view_const_iterator = codepoint_iterator<const octet_range&, const char*>;
+
+    static view_const_iterator cbegin(const string_view & str);
+
+    static view_const_iterator cend(const string_view & str);
+
+    static bool advance_safe(const string_view & str, view_const_iterator & it, offset_type offset);
+
+    static offset_type get_byte_distance(const string_view & str, const view_const_iterator & b, const view_const_iterator & it);
+
+    static offset_type get_codepoint_distance(const string_view & str, const view_const_iterator & b, const view_const_iterator & it);
 };
 
 class as_graphemes
@@ -223,6 +355,21 @@ public:
     static offset_type get_byte_distance(const string & str, const const_iterator & b, const const_iterator & it);
 
     static offset_type get_codepoint_distance(const string & str, const const_iterator & b, const const_iterator & it);
+
+    /**
+     * Same as above, for the buffers browsed through a string_view.
+     */
+    using view_const_iterator = grapheme_iterator<const octet_range&, codepoint_iterator<const octet_range&, const char*>>;
+
+    static view_const_iterator cbegin(const string_view & str);
+
+    static view_const_iterator cend(const string_view & str);
+
+    static bool advance_safe(const string_view & str, view_const_iterator & it, offset_type offset);
+
+    static offset_type get_byte_distance(const string_view & str, const view_const_iterator & b, const view_const_iterator & it);
+
+    static offset_type get_codepoint_distance(const string_view & str, const view_const_iterator & b, const view_const_iterator & it);
 };
 
 class string
@@ -232,11 +379,33 @@ public:
     using iterator = codepoint_iterator<std::string&, std::string::iterator>;
     using const_iterator = codepoint_iterator<const std::string&, std::string::const_iterator>;
 
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    /**
+     * Number of codepoints between two entries of the codepoint index (see build_codepoint_index()).
+     */
+    static const std::size_t CODEPOINT_INDEX_STRIDE = 128;
+
+    /**
+     * Number of graphemes between two entries of the grapheme index (see build_grapheme_index()).
+     */
+    static const std::size_t GRAPHEME_INDEX_STRIDE = 64;
+
     using reverse_iterator = std::reverse_iterator<string::iterator>;
     using const_reverse_iterator = std::reverse_iterator<string::const_iterator>;
 
     using const_grapheme_iterator = grapheme_iterator<const string&, const_iterator>;
 
+    /**
+     * Iterator replacing malformed UTF-8 by REPLACEMENT_CHARACTER instead of throwing.
+     */
+    using const_lossy_iterator = codepoint_iterator<const std::string&, std::string::const_iterator, lossy_decoding>;
+
+    /**
+     * Iterator that does not validate the string at all, only usable if the string is known to be valid.
+     */
+    using const_trusted_iterator = codepoint_iterator<const std::string&, std::string::const_iterator, trusted_decoding>;
+
     string();
     string(const char* str);
     string(const char* str, std::size_t size);
@@ -245,15 +414,80 @@ public:
     string(const std::u16string& utf16str);
     string(const std::u32string& utf32str);
 
-    std::string& std_str();
+    /**
+     * wchar_t strings are UTF-32 or UTF-16 depending on the width of wchar_t on the platform.
+     */
+    string(const std::wstring& wstr);
+
+    /**
+     * Copies the octets of a view (see string_view).
+     */
+    explicit string(const string_view& view);
+
+    string(const string& other);
+    string(string&& other);
+
+    string& operator=(const string& other);
+    string& operator=(string&& other);
+
     const std::string& std_str() const;
 
-    std::wstring w_str();
+    /**
+     * Calls function with a mutable reference to the underlying UTF-8 string, then
+     * invalidates the cached counts and indexes (see codepoints_count()), even if
+     * function throws. The reference must not be kept after function returns.
+     */
+    template<typename Function>
+    string& modify(Function function)
+    {
+        try
+        {
+            function(m_content);
+        }
+        catch(...)
+        {
+            invalidate_caches();
+            throw;
+        }
+
+        invalidate_caches();
+        return *this;
+    }
+
+    /**
+     * Returns the string as UTF-32 or UTF-16 depending on the width of wchar_t (see string(const std::wstring&)).
+     */
+    std::wstring w_str() const;
     std::u16string utf16_str() const;
     std::u32string utf32_str() const;
 
+    std::u16string utf16_str(lossy_decoding) const;
+    std::u32string utf32_str(lossy_decoding) const;
+
+    /**
+     * Same as utf16_str() and utf32_str() but write the result in buffer, reusing its
+     * storage (no allocation once the buffer is large enough).
+     * The content of buffer is unspecified if an exception is thrown.
+     */
+    void utf16_into(std::u16string& buffer) const;
+    void utf32_into(std::u32string& buffer) const;
+
+    void utf16_into(std::u16string& buffer, lossy_decoding) const;
+    void utf32_into(std::u32string& buffer, lossy_decoding) const;
+
     bool is_valid() const;
 
+    /**
+     * Replaces, in place, every malformed sequence by REPLACEMENT_CHARACTER (see decode_next_lossy).
+     * A valid string is left untouched.
+     */
+    string& sanitize();
+
+    /**
+     * Returns a copy of the string with every malformed sequence replaced by REPLACEMENT_CHARACTER.
+     */
+    string sanitized() const;
+
     const_iterator begin() const;
     const_iterator cbegin() const;
     const_reverse_iterator rbegin() const;
@@ -268,17 +502,131 @@ public:
     iterator end();
     reverse_iterator rend();
 
+    const_lossy_iterator cbegin(lossy_decoding) const;
+    const_lossy_iterator cend(lossy_decoding) const;
+
+    const_trusted_iterator cbegin(trusted_decoding) const;
+    const_trusted_iterator cend(trusted_decoding) const;
+
     const_grapheme_iterator gbegin() const;
     const_grapheme_iterator gend() const;
 
+    /**
+     * Returns the number of codepoints (resp. graphemes) of the string.
+     * The counts are computed on the first call and cached until the string is
+     * modified (through modify() or sanitize()).
+     */
+    std::size_t codepoints_count() const;
+    std::size_t graphemes_count() const;
+
+    /**
+     * Builds the codepoint index: the offset of every CODEPOINT_INDEX_STRIDE-th codepoint,
+     * computed in one pass. With the index, at(), substr(), nth() and as_codepoints::advance_safe
+     * seek in constant or logarithmic time instead of walking the codepoints.
+     * The index is patched by append() and dropped by the other modifications.
+     * Throws if the string is not valid.
+     */
+    void build_codepoint_index();
+    bool has_codepoint_index() const;
+
+    /**
+     * Returns the offset in octets of the nth codepoint (the size in octets if n is
+     * codepoints_count()). Throws std::out_of_range if n is greater than codepoints_count().
+     */
+    std::size_t codepoint_offset(std::size_t n) const;
+
+    /**
+     * Returns the number of codepoints before an offset in octets.
+     */
+    std::size_t codepoint_index(std::size_t offset) const;
+
+    /**
+     * Returns the nth codepoint, throws std::out_of_range if n is not lower than codepoints_count().
+     */
+    char32_t at(std::size_t n) const;
+
+    /**
+     * Returns an iterator on the nth codepoint, throws std::out_of_range if n is greater than codepoints_count().
+     */
+    const_iterator nth(std::size_t n) const;
+
+    /**
+     * Returns the codepoints [pos, pos + count) (or [pos, codepoints_count()) if the string is shorter).
+     * Throws std::out_of_range if pos is greater than codepoints_count().
+     */
+    string substr(std::size_t pos, std::size_t count = npos) const;
+
+    /**
+     * Builds the grapheme index: the offset (and segmentation state) of every
+     * GRAPHEME_INDEX_STRIDE-th grapheme. With the index, nth_grapheme() and
+     * as_graphemes::advance_safe seek in logarithmic time instead of segmenting the
+     * string from its beginning. The index is repaired by append() and replace(),
+     * which only segment again the graphemes around the modification, and dropped by
+     * the other modifications. Throws if the string is not valid.
+     */
+    void build_grapheme_index();
+    bool has_grapheme_index() const;
+
+    /**
+     * Returns an iterator on the nth grapheme, throws std::out_of_range if n is greater than graphemes_count().
+     */
+    const_grapheme_iterator nth_grapheme(std::size_t n) const;
+
+    /**
+     * Returns the number of graphemes starting before an offset in octets.
+     */
+    std::size_t grapheme_index(std::size_t offset) const;
+
+    string& append(const string& other);
+
+    /**
+     * Replaces the codepoints [pos, pos + count) (or [pos, codepoints_count()) if the string is shorter)
+     * by replacement. Throws std::out_of_range if pos is greater than codepoints_count().
+     */
+    string& replace(std::size_t pos, std::size_t count, const string& replacement);
+
     template<typename Unit = as_codepoints>
     std::size_t size() const
     {
-        return std::distance(Unit::cbegin(*this), Unit::cend(*this));
+        return size(static_cast<Unit*>(nullptr));
     }
 
 private:
+    template<typename Unit>
+    std::size_t size(Unit*) const
+    {
+        return std::distance(Unit::cbegin(*this), Unit::cend(*this));
+    }
+
+    std::size_t size(as_codepoints*) const { return codepoints_count(); }
+    std::size_t size(as_graphemes*) const { return graphemes_count(); }
+
+    struct grapheme_index_entry
+    {
+        std::size_t offset;
+        std::size_t grapheme;
+        utf8proc_int32_t state; // Segmentation state at offset
+    };
+
+    void invalidate_caches();
+    void check_valid() const;
+    void reindex_codepoints(std::size_t pos, std::size_t offset);
+    void repair_grapheme_index(std::size_t begin, std::size_t old_end, std::size_t new_end);
+    std::size_t grapheme_offset(const const_grapheme_iterator& it) const;
+
+    static const std::size_t unknown_count = static_cast<std::size_t>(-1);
+
     std::string m_content;
+
+    // Atomic so that concurrent const accesses can fill the caches
+    mutable std::atomic<std::size_t> m_codepoints_count;
+    mutable std::atomic<std::size_t> m_graphemes_count;
+
+    // Built on demand only, so that const accesses never modify it
+    std::vector<std::size_t> m_codepoint_index;
+    bool m_has_codepoint_index;
+    std::vector<grapheme_index_entry> m_grapheme_index;
+    bool m_has_grapheme_index;
 };
 
 }
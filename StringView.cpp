@@ -0,0 +1,349 @@
+#include "StringView.hpp"
+
+#include "Utf8Simd.hpp"
+#include "Utf8Transcode.hpp"
+#include "WideEncoding.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace unicpp
+{
+
+namespace
+{
+
+/**
+ * Skips up to count codepoints (until end), decrementing count for each one.
+ * Throws the exceptions of codepoint_iterator if they are not valid.
+ */
+const char* skip_codepoints(const char* it, const char* end, std::size_t& count)
+{
+    for(; count > 0 && it != end; --count)
+    {
+        const char* sequence = it;
+        utf8_decode_result result = decode_next(it, end);
+        if(result.status != utf8_status::ok)
+            throw_utf8_error(result, static_cast<unsigned char>(*sequence));
+    }
+
+    return it;
+}
+
+}
+
+string_view::string_view() :
+    m_octets()
+{
+
+}
+
+string_view::string_view(const char* data, std::size_t size) :
+    m_octets(data, data + size)
+{
+
+}
+
+string_view::string_view(const char* str) :
+    string_view(str, std::strlen(str))
+{
+
+}
+
+string_view::string_view(const std::string& str) :
+    string_view(str.data(), str.size())
+{
+
+}
+
+string_view::string_view(const string& str) :
+    string_view(str.std_str())
+{
+
+}
+
+const char* string_view::octets_begin() const
+{
+    return m_octets.begin();
+}
+
+const char* string_view::octets_end() const
+{
+    return m_octets.end();
+}
+
+std::size_t string_view::octets_count() const
+{
+    return m_octets.size();
+}
+
+bool string_view::empty() const
+{
+    return m_octets.size() == 0;
+}
+
+std::wstring string_view::w_str() const
+{
+    std::wstring result;
+    result.resize(platform_wide_encoding::length_from_utf8(octets_begin(), octets_end()));
+    wchar_t* output = &result[0];
+    wchar_t* output_end = transcode_utf8_to_wide(octets_begin(), octets_end(), output);
+    result.resize(output_end - output);
+
+    return result;
+}
+
+std::u16string string_view::utf16_str() const
+{
+    std::u16string result;
+    utf16_into(result);
+
+    return result;
+}
+
+std::u32string string_view::utf32_str() const
+{
+    std::u32string result;
+    utf32_into(result);
+
+    return result;
+}
+
+std::u16string string_view::utf16_str(lossy_decoding) const
+{
+    std::u16string result;
+    utf16_into(result, lossy_decoding());
+
+    return result;
+}
+
+std::u32string string_view::utf32_str(lossy_decoding) const
+{
+    std::u32string result;
+    utf32_into(result, lossy_decoding());
+
+    return result;
+}
+
+void string_view::utf16_into(std::u16string& buffer) const
+{
+    // The length is only an upper bound for some invalid inputs, hence the final resize
+    buffer.resize(utf16_length_from_utf8(octets_begin(), octets_end()));
+    char16_t* output_end = transcode_utf8_to_utf16(octets_begin(), octets_end(), &buffer[0]);
+    buffer.resize(output_end - &buffer[0]);
+}
+
+void string_view::utf32_into(std::u32string& buffer) const
+{
+    buffer.resize(utf32_length_from_utf8(octets_begin(), octets_end()));
+    char32_t* output_end = transcode_utf8_to_utf32(octets_begin(), octets_end(), &buffer[0]);
+    buffer.resize(output_end - &buffer[0]);
+}
+
+void string_view::utf16_into(std::u16string& buffer, lossy_decoding) const
+{
+    if(is_valid())
+        return utf16_into(buffer);
+
+    // Invalid sequences are replaced so the length must be computed by decoding them
+    const char* begin = octets_begin();
+    const char* end = octets_end();
+
+    std::size_t length = 0;
+    for(const char* it = begin; it != end; )
+        length += (decode_next_lossy(it, end) > 0xFFFF) ? 2 : 1;
+
+    buffer.resize(length);
+    utf8_to_utf16(begin, end, &buffer[0], lossy_decoding());
+}
+
+void string_view::utf32_into(std::u32string& buffer, lossy_decoding) const
+{
+    if(is_valid())
+        return utf32_into(buffer);
+
+    const char* begin = octets_begin();
+    const char* end = octets_end();
+
+    std::size_t length = 0;
+    for(const char* it = begin; it != end; ++length)
+        decode_next_lossy(it, end);
+
+    buffer.resize(length);
+    utf8_to_utf32(begin, end, &buffer[0], lossy_decoding());
+}
+
+bool string_view::is_valid() const
+{
+    return validate_utf8(octets_begin(), octets_count());
+}
+
+std::size_t string_view::codepoints_count() const
+{
+    // Counting the leading octets is only correct for valid strings
+    check_valid();
+
+    return count_utf8_codepoints(octets_begin(), octets_count());
+}
+
+std::size_t string_view::graphemes_count() const
+{
+    return std::distance(gbegin(), gend());
+}
+
+std::size_t string_view::codepoint_offset(std::size_t n) const
+{
+    // Only the codepoints before the nth one are decoded (and validated)
+    const char* it = skip_codepoints(octets_begin(), octets_end(), n);
+    if(n > 0)
+        throw std::out_of_range("unicpp::string_view: codepoint index out of range");
+
+    return it - octets_begin();
+}
+
+std::size_t string_view::codepoint_index(std::size_t offset) const
+{
+    check_valid();
+
+    return count_utf8_codepoints(octets_begin(), std::min(offset, octets_count()));
+}
+
+char32_t string_view::at(std::size_t n) const
+{
+    const char* it = octets_begin() + codepoint_offset(n);
+    if(it == octets_end())
+        throw std::out_of_range("unicpp::string_view: codepoint index out of range");
+
+    return iterate_next(it, octets_end());
+}
+
+string_view::const_iterator string_view::nth(std::size_t n) const
+{
+    return const_iterator(m_octets, octets_begin() + codepoint_offset(n));
+}
+
+string_view::const_grapheme_iterator string_view::nth_grapheme(std::size_t n) const
+{
+    const_grapheme_iterator it = gbegin();
+    const_grapheme_iterator end = gend();
+    for(; n > 0; --n, ++it)
+    {
+        if(it == end)
+            throw std::out_of_range("unicpp::string_view: grapheme index out of range");
+    }
+
+    return it;
+}
+
+std::size_t string_view::grapheme_index(std::size_t offset) const
+{
+    offset = std::min(offset, octets_count());
+
+    std::size_t grapheme = 0;
+    for(const_grapheme_iterator it = gbegin(); it.codepoint_it.internal_it - octets_begin() < static_cast<std::ptrdiff_t>(offset); ++it)
+        ++grapheme;
+
+    return grapheme;
+}
+
+string_view string_view::substr(std::size_t pos, std::size_t count) const
+{
+    const char* begin = skip_codepoints(octets_begin(), octets_end(), pos);
+    if(pos > 0)
+        throw std::out_of_range("unicpp::string_view: codepoint index out of range");
+
+    const char* end = skip_codepoints(begin, octets_end(), count);
+    return string_view(begin, end - begin);
+}
+
+string_view string_view::octets_substr(std::size_t offset, std::size_t count) const
+{
+    if(offset > octets_count())
+        throw std::out_of_range("unicpp::string_view: octet offset out of range");
+
+    return string_view(octets_begin() + offset, std::min(count, octets_count() - offset));
+}
+
+void string_view::check_valid() const
+{
+    std::size_t invalid = find_invalid_utf8(octets_begin(), octets_count());
+    if(invalid == octets_count())
+        return;
+
+    // Throws the same error as the iterators
+    const char* it = octets_begin() + invalid;
+    throw_utf8_error(decode_next(it, octets_end()), static_cast<unsigned char>(*it));
+}
+
+string_view::const_iterator string_view::begin() const
+{
+    return const_iterator(m_octets, m_octets.begin());
+}
+
+string_view::const_iterator string_view::cbegin() const
+{
+    return const_iterator(m_octets, m_octets.begin());
+}
+
+string_view::const_reverse_iterator string_view::rbegin() const
+{
+    return const_reverse_iterator(begin());
+}
+
+string_view::const_reverse_iterator string_view::crbegin() const
+{
+    return const_reverse_iterator(cbegin());
+}
+
+string_view::const_iterator string_view::end() const
+{
+    return const_iterator(m_octets, m_octets.end());
+}
+
+string_view::const_iterator string_view::cend() const
+{
+    return const_iterator(m_octets, m_octets.end());
+}
+
+string_view::const_reverse_iterator string_view::rend() const
+{
+    return const_reverse_iterator(end());
+}
+
+string_view::const_reverse_iterator string_view::crend() const
+{
+    return const_reverse_iterator(cend());
+}
+
+string_view::const_lossy_iterator string_view::cbegin(lossy_decoding) const
+{
+    return const_lossy_iterator(m_octets, m_octets.begin());
+}
+
+string_view::const_lossy_iterator string_view::cend(lossy_decoding) const
+{
+    return const_lossy_iterator(m_octets, m_octets.end());
+}
+
+string_view::const_trusted_iterator string_view::cbegin(trusted_decoding) const
+{
+    return const_trusted_iterator(m_octets, m_octets.begin());
+}
+
+string_view::const_trusted_iterator string_view::cend(trusted_decoding) const
+{
+    return const_trusted_iterator(m_octets, m_octets.end());
+}
+
+string_view::const_grapheme_iterator string_view::gbegin() const
+{
+    return const_grapheme_iterator(m_octets, cbegin());
+}
+
+string_view::const_grapheme_iterator string_view::gend() const
+{
+    return const_grapheme_iterator(m_octets, cend());
+}
+
+}
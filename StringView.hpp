@@ -0,0 +1,151 @@
+#ifndef UNICPP_STRINGVIEW_H
+#define UNICPP_STRINGVIEW_H
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+
+#include "String.hpp"
+
+namespace unicpp
+{
+
+/**
+ * Non-owning, read-only view of a UTF-8 buffer (a string, a slice of a larger buffer, a
+ * mapped_file...), with the read-only operations of string working directly on the buffer:
+ * nothing is copied, not even by substr().
+ *
+ * The iterators only refer to the buffer, they stay valid after the view is destroyed.
+ * Unlike string, the view does not cache its counts nor have indexes: codepoints_count(),
+ * graphemes_count() and the random accesses scan the buffer on every call.
+ */
+class string_view
+{
+public:
+    using const_iterator = codepoint_iterator<const octet_range&, const char*>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    using const_grapheme_iterator = grapheme_iterator<const octet_range&, const_iterator>;
+
+    /**
+     * Iterator replacing malformed UTF-8 by REPLACEMENT_CHARACTER instead of throwing.
+     */
+    using const_lossy_iterator = codepoint_iterator<const octet_range&, const char*, lossy_decoding>;
+
+    /**
+     * Iterator that does not validate the buffer at all, only usable if it is known to be valid.
+     */
+    using const_trusted_iterator = codepoint_iterator<const octet_range&, const char*, trusted_decoding>;
+
+    static const std::size_t npos = static_cast<std::size_t>(-1);
+
+    string_view();
+    string_view(const char* data, std::size_t size);
+
+    /**
+     * Views of a null-terminated string (without the terminator), of a std::string and of a
+     * string. They are cheap (no copy nor scan) and implicit, so that a view can be passed
+     * wherever a string_view is expected. The view is invalidated when the string is modified.
+     */
+    string_view(const char* str);
+    string_view(const std::string& str);
+    string_view(const string& str);
+
+    const char* octets_begin() const;
+    const char* octets_end() const;
+    std::size_t octets_count() const;
+    bool empty() const;
+
+    /**
+     * Same as the conversions of string.
+     */
+    std::wstring w_str() const;
+    std::u16string utf16_str() const;
+    std::u32string utf32_str() const;
+
+    std::u16string utf16_str(lossy_decoding) const;
+    std::u32string utf32_str(lossy_decoding) const;
+
+    void utf16_into(std::u16string& buffer) const;
+    void utf32_into(std::u32string& buffer) const;
+
+    void utf16_into(std::u16string& buffer, lossy_decoding) const;
+    void utf32_into(std::u32string& buffer, lossy_decoding) const;
+
+    bool is_valid() const;
+
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+
+    const_iterator end() const;
+    const_iterator cend() const;
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    const_lossy_iterator cbegin(lossy_decoding) const;
+    const_lossy_iterator cend(lossy_decoding) const;
+
+    const_trusted_iterator cbegin(trusted_decoding) const;
+    const_trusted_iterator cend(trusted_decoding) const;
+
+    const_grapheme_iterator gbegin() const;
+    const_grapheme_iterator gend() const;
+
+    /**
+     * Returns the number of codepoints (resp. graphemes) of the view.
+     * codepoints_count() throws if the view is not valid.
+     */
+    std::size_t codepoints_count() const;
+    std::size_t graphemes_count() const;
+
+    /**
+     * Same as the random accesses of string: they throw std::out_of_range if n (or pos) is
+     * out of range, and the ones counting codepoints throw if the view is not valid.
+     */
+    std::size_t codepoint_offset(std::size_t n) const;
+    std::size_t codepoint_index(std::size_t offset) const;
+    char32_t at(std::size_t n) const;
+    const_iterator nth(std::size_t n) const;
+    const_grapheme_iterator nth_grapheme(std::size_t n) const;
+    std::size_t grapheme_index(std::size_t offset) const;
+
+    /**
+     * Returns a view of the codepoints [pos, pos + count) (or [pos, codepoints_count()) if the
+     * view is shorter), over the same buffer.
+     * Throws std::out_of_range if pos is greater than codepoints_count().
+     */
+    string_view substr(std::size_t pos, std::size_t count = npos) const;
+
+    /**
+     * Returns a view of the octets [offset, offset + count) (or [offset, octets_count()) if the
+     * view is shorter), for instance the octets of a grapheme_view.
+     * Throws std::out_of_range if offset is greater than octets_count().
+     */
+    string_view octets_substr(std::size_t offset, std::size_t count = npos) const;
+
+    template<typename Unit = as_codepoints>
+    std::size_t size() const
+    {
+        return size(static_cast<Unit*>(nullptr));
+    }
+
+private:
+    template<typename Unit>
+    std::size_t size(Unit*) const
+    {
+        return std::distance(Unit::cbegin(*this), Unit::cend(*this));
+    }
+
+    std::size_t size(as_codepoints*) const { return codepoints_count(); }
+    std::size_t size(as_graphemes*) const { return graphemes_count(); }
+
+    void check_valid() const;
+
+    octet_range m_octets;
+};
+
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "String.hpp"
 
+#include "StringView.hpp"
+
 namespace unicpp
 {
 
@@ -15,6 +17,19 @@ as_codepoints::const_iterator as_codepoints::cend(const string & str)
 
 bool as_codepoints::advance_safe(const string & str, as_codepoints::const_iterator & it, as_codepoints::offset_type offset)
 {
+    if(str.has_codepoint_index())
+    {
+        std::size_t target = str.codepoint_index(std::distance(str.std_str().begin(), it.internal_it)) + offset;
+        if(target > str.codepoints_count())
+        {
+            it = cend(str);
+            return false;
+        }
+
+        it = str.nth(target);
+        return true;
+    }
+
     while(it != cend(str) && offset > 0)
     {
         --offset;
@@ -37,6 +52,35 @@ as_codepoints::offset_type get_codepoint_distance(const string & str, const as_c
     return std::distance(b, it);
 }
 
+as_codepoints::view_const_iterator as_codepoints::cbegin(const string_view & str)
+{
+    return str.cbegin();
+}
+
+as_codepoints::view_const_iterator as_codepoints::cend(const string_view & str)
+{
+    return str.cend();
+}
+
+bool as_codepoints::advance_safe(const string_view & str, as_codepoints::view_const_iterator & it, as_codepoints::offset_type offset)
+{
+    auto end = cend(str);
+    for(; it != end && offset > 0; --offset)
+        ++it;
+
+    return offset == 0;
+}
+
+as_codepoints::offset_type as_codepoints::get_byte_distance(const string_view & str, const as_codepoints::view_const_iterator & b, const as_codepoints::view_const_iterator & it)
+{
+    return std::distance(b.internal_it, it.internal_it);
+}
+
+as_codepoints::offset_type as_codepoints::get_codepoint_distance(const string_view & str, const as_codepoints::view_const_iterator & b, const as_codepoints::view_const_iterator & it)
+{
+    return std::distance(b, it);
+}
+
 as_graphemes::const_iterator as_graphemes::cbegin(const string & str)
 {
     return str.gbegin();
@@ -49,6 +93,19 @@ as_graphemes::const_iterator as_graphemes::cend(const string & str)
 
 bool as_graphemes::advance_safe(const string & str, as_graphemes::const_iterator & it, as_graphemes::offset_type offset)
 {
+    if(str.has_grapheme_index())
+    {
+        std::size_t target = str.grapheme_index(std::distance(str.std_str().begin(), it.codepoint_it.internal_it)) + offset;
+        if(target > str.graphemes_count())
+        {
+            it = cend(str);
+            return false;
+        }
+
+        it = str.nth_grapheme(target);
+        return true;
+    }
+
     while(it != cend(str) && offset > 0)
     {
         --offset;
@@ -71,4 +128,34 @@ as_graphemes::offset_type as_graphemes::get_codepoint_distance(const string & st
     return std::distance(b.codepoint_it, it.codepoint_it);
 }
 
+
+as_graphemes::view_const_iterator as_graphemes::cbegin(const string_view & str)
+{
+    return str.gbegin();
+}
+
+as_graphemes::view_const_iterator as_graphemes::cend(const string_view & str)
+{
+    return str.gend();
+}
+
+bool as_graphemes::advance_safe(const string_view & str, as_graphemes::view_const_iterator & it, as_graphemes::offset_type offset)
+{
+    auto end = cend(str);
+    for(; it != end && offset > 0; --offset)
+        ++it;
+
+    return offset == 0;
+}
+
+as_graphemes::offset_type as_graphemes::get_byte_distance(const string_view & str, const as_graphemes::view_const_iterator & b, const as_graphemes::view_const_iterator & it)
+{
+    return std::distance(b.codepoint_it.internal_it, it.codepoint_it.internal_it);
+}
+
+as_graphemes::offset_type as_graphemes::get_codepoint_distance(const string_view & str, const as_graphemes::view_const_iterator & b, const as_graphemes::view_const_iterator & it)
+{
+    return std::distance(b.codepoint_it, it.codepoint_it);
+}
+
 }
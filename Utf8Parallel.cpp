@@ -0,0 +1,222 @@
+#include "Utf8Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "Utf8Simd.hpp"
+#include "Utf8Tools.hpp"
+
+namespace unicpp
+{
+
+namespace
+{
+
+/**
+ * Counts the tasks given to an executor which are not done yet.
+ */
+class task_group
+{
+public:
+    explicit task_group(std::size_t tasks) : m_remaining(tasks) {}
+
+    void done(std::size_t tasks = 1)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_remaining -= tasks;
+        if(m_remaining == 0)
+            m_finished.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this]() { return m_remaining == 0; });
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_finished;
+    std::size_t m_remaining;
+};
+
+/**
+ * Returns the boundaries of at most count chunks of [0, length) (the first one is 0 and the
+ * last one length), of at least PARALLEL_MIN_CHUNK_SIZE octets.
+ *
+ * With on_codepoints, the chunks start on a non-continuation octet: up to the first error, it
+ * is always the beginning of a sequence, so each chunk can be validated on its own. After
+ * 3 continuation octets, the chunk starts on the fourth one, which is invalid anyway.
+ */
+std::vector<std::size_t> split(const char* data, std::size_t length, std::size_t count, bool on_codepoints)
+{
+    count = std::max<std::size_t>(count, 1);
+    std::size_t chunk_size = std::max((length + count - 1) / count, PARALLEL_MIN_CHUNK_SIZE);
+
+    std::vector<std::size_t> boundaries(1, 0);
+    for(std::size_t boundary = chunk_size; boundary < length; boundary += chunk_size)
+    {
+        std::size_t start = boundary;
+        if(on_codepoints)
+        {
+            for(std::size_t i = 0; i < 3 && start < length && is_trail_octet(data[start]); ++i)
+                ++start;
+        }
+
+        if(start < length)
+            boundaries.push_back(start);
+    }
+    boundaries.push_back(length);
+
+    return boundaries;
+}
+
+std::size_t get_threads(std::size_t threads)
+{
+    if(threads == 0)
+        threads = std::thread::hardware_concurrency();
+
+    return std::max<std::size_t>(threads, 1);
+}
+
+/**
+ * Calls scan(i) for every chunk i, on the executor or (if run is null) on new threads and
+ * the calling thread. Returns once every chunk is scanned.
+ */
+template<typename Scan>
+void scan_chunks(std::size_t chunks, const executor* run, Scan scan)
+{
+    if(chunks == 1)
+    {
+        scan(0);
+        return;
+    }
+
+    if(run)
+    {
+        task_group group(chunks);
+        std::size_t submitted = 0;
+        try
+        {
+            for(; submitted < chunks; ++submitted)
+            {
+                (*run)([&group, &scan, submitted]() {
+                    scan(submitted);
+                    group.done();
+                });
+            }
+        }
+        catch(...)
+        {
+            // The submitted tasks still use the group and the results
+            group.done(chunks - submitted);
+            group.wait();
+            throw;
+        }
+
+        group.wait();
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+
+    std::size_t next = 1;
+    try
+    {
+        for(; next < chunks; ++next)
+            threads.emplace_back(scan, next);
+    }
+    catch(const std::system_error&)
+    {
+        // No more threads: the calling thread scans the remaining chunks
+    }
+
+    scan(0);
+    for(; next < chunks; ++next)
+        scan(next);
+
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+std::size_t find_invalid(const char* data, std::size_t length, std::size_t count, const executor* run)
+{
+    std::vector<std::size_t> boundaries = split(data, length, count, true);
+    std::atomic<std::size_t> first_invalid(length);
+
+    scan_chunks(boundaries.size() - 1, run, [&](std::size_t i) {
+        // The chunks after a known error cannot change the result
+        if(boundaries[i] >= first_invalid.load(std::memory_order_relaxed))
+            return;
+
+        std::size_t chunk_length = boundaries[i + 1] - boundaries[i];
+        std::size_t invalid = find_invalid_utf8(data + boundaries[i], chunk_length);
+        if(invalid == chunk_length)
+            return;
+
+        invalid += boundaries[i];
+        std::size_t current = first_invalid.load(std::memory_order_relaxed);
+        while(invalid < current && !first_invalid.compare_exchange_weak(current, invalid, std::memory_order_relaxed))
+        {
+        }
+    });
+
+    return first_invalid.load(std::memory_order_relaxed);
+}
+
+std::size_t count_codepoints(const char* data, std::size_t length, std::size_t count, const executor* run)
+{
+    // The counts of the chunks simply add up, the chunks can start anywhere
+    std::vector<std::size_t> boundaries = split(data, length, count, false);
+    std::vector<std::size_t> counts(boundaries.size() - 1, 0);
+
+    scan_chunks(counts.size(), run, [&](std::size_t i) {
+        counts[i] = count_utf8_codepoints(data + boundaries[i], boundaries[i + 1] - boundaries[i]);
+    });
+
+    std::size_t total = 0;
+    for(std::size_t c : counts)
+        total += c;
+
+    return total;
+}
+
+}
+
+std::size_t find_invalid_utf8_parallel(const char* data, std::size_t length, std::size_t threads)
+{
+    return find_invalid(data, length, get_threads(threads), nullptr);
+}
+
+std::size_t find_invalid_utf8_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run)
+{
+    return find_invalid(data, length, tasks, &run);
+}
+
+bool validate_utf8_parallel(const char* data, std::size_t length, std::size_t threads)
+{
+    return find_invalid_utf8_parallel(data, length, threads) == length;
+}
+
+bool validate_utf8_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run)
+{
+    return find_invalid_utf8_parallel(data, length, tasks, run) == length;
+}
+
+std::size_t count_utf8_codepoints_parallel(const char* data, std::size_t length, std::size_t threads)
+{
+    return count_codepoints(data, length, get_threads(threads), nullptr);
+}
+
+std::size_t count_utf8_codepoints_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run)
+{
+    return count_codepoints(data, length, tasks, &run);
+}
+
+}
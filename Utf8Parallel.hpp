@@ -0,0 +1,56 @@
+#ifndef UNICPP_UTF8PARALLEL_H
+#define UNICPP_UTF8PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * \file Contains the multithreaded versions of the scans of Utf8Simd.hpp, for large buffers
+ * (files, bulk imports...). The buffer is split into chunks starting on a codepoint boundary
+ * (a non-continuation octet), the chunks are scanned concurrently by the vectorized kernels,
+ * and the results are merged: they are exactly the ones of the single-threaded scans.
+ */
+
+namespace unicpp
+{
+
+/**
+ * Runs a task, possibly asynchronously on another thread: for instance by posting it to a
+ * thread pool. Every task must be run exactly once.
+ */
+using executor = std::function<void(std::function<void()>)>;
+
+/**
+ * Minimum size of the chunks scanned concurrently: the smaller buffers are scanned by fewer
+ * tasks (or only by the calling thread), as starting a task would take longer than the scan.
+ */
+const std::size_t PARALLEL_MIN_CHUNK_SIZE = 256 * 1024;
+
+/**
+ * Same as find_invalid_utf8, scanning the buffer on up to threads threads (including the
+ * calling one). 0 stands for the number of hardware threads.
+ */
+std::size_t find_invalid_utf8_parallel(const char* data, std::size_t length, std::size_t threads = 0);
+
+/**
+ * Same as find_invalid_utf8, scanning the buffer in up to tasks tasks run by run.
+ * Returns once all the tasks are done: run must not only queue the tasks for the calling thread.
+ */
+std::size_t find_invalid_utf8_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run);
+
+/**
+ * Same as validate_utf8, see find_invalid_utf8_parallel.
+ */
+bool validate_utf8_parallel(const char* data, std::size_t length, std::size_t threads = 0);
+bool validate_utf8_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run);
+
+/**
+ * Same as count_utf8_codepoints, see find_invalid_utf8_parallel. As for count_utf8_codepoints,
+ * the result is meaningless if the buffer is not valid.
+ */
+std::size_t count_utf8_codepoints_parallel(const char* data, std::size_t length, std::size_t threads = 0);
+std::size_t count_utf8_codepoints_parallel(const char* data, std::size_t length, std::size_t tasks, const executor& run);
+
+}
+
+#endif
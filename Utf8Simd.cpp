@@ -0,0 +1,688 @@
+#include "Utf8Simd.hpp"
+
+#include "Utf8Tools.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define UNICPP_SIMD_X86
+#include <immintrin.h>
+#define UNICPP_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define UNICPP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace unicpp
+{
+
+namespace
+{
+
+/**
+ * Returns the first octet of the first invalid sequence, or end.
+ */
+const unsigned char* find_invalid_utf8_scalar(const unsigned char* it, const unsigned char* end)
+{
+    while(it != end)
+    {
+        // Skip 8 octets at once while they are all ASCII
+        if(end - it >= 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, it, 8);
+            if((word & 0x8080808080808080ull) == 0)
+            {
+                it += 8;
+                continue;
+            }
+        }
+
+        unsigned char lead = *it;
+        if(lead < 0x80)
+        {
+            ++it;
+        }
+        else if(lead < 0xC2) // Trail octet or 0xC0/0xC1
+        {
+            return it;
+        }
+        else if(lead < 0xE0)
+        {
+            if(end - it < 2 || !is_trail_octet(it[1]))
+                return it;
+
+            it += 2;
+        }
+        else if(lead < 0xF0)
+        {
+            if(end - it < 3 || !is_trail_octet(it[1]) || !is_trail_octet(it[2]))
+                return it;
+            if(lead == 0xED && it[1] >= 0xA0) // UTF-16 surrogates
+                return it;
+            if(lead == 0xEF && it[1] == 0xBF && it[2] >= 0xBE) // U+FFFE and U+FFFF
+                return it;
+
+            it += 3;
+        }
+        else if(lead < 0xF5)
+        {
+            if(end - it < 4 || !is_trail_octet(it[1]) || !is_trail_octet(it[2]) || !is_trail_octet(it[3]))
+                return it;
+            if(lead == 0xF4 && it[1] >= 0x90) // Above CODE_POINT_MAX
+                return it;
+            if(lead == 0xF0 && it[1] == 0x8D && it[2] >= 0xA0) // Overlong UTF-16 surrogates
+                return it;
+            if(lead == 0xF0 && it[1] == 0x8F && it[2] == 0xBF && it[3] >= 0xBE) // Overlong U+FFFE and U+FFFF
+                return it;
+
+            it += 4;
+        }
+        else // 0xF5 to 0xFF can only encode codepoints above CODE_POINT_MAX
+        {
+            return it;
+        }
+    }
+
+    return end;
+}
+
+bool validate_utf8_scalar(const unsigned char* it, const unsigned char* end)
+{
+    return find_invalid_utf8_scalar(it, end) == end;
+}
+
+/**
+ * Returns the offset of the first invalid sequence, knowing that the vectorized validator
+ * found the first error in the block starting at block_offset: the error is either in the
+ * block or in an unfinished sequence just before it.
+ */
+std::size_t find_invalid_utf8_from_block(const unsigned char* data, std::size_t length, std::size_t block_offset)
+{
+    std::size_t start = block_offset;
+    while(start > 0 && block_offset - start < 4)
+    {
+        --start;
+        if(!is_trail_octet(data[start]))
+            break;
+    }
+
+    return find_invalid_utf8_scalar(data + start, data + length) - data;
+}
+
+std::size_t index_utf8_codepoints_scalar(const unsigned char* data, std::size_t length, std::size_t first, std::size_t stride, std::vector<std::size_t>& offsets)
+{
+    std::size_t count = 0;
+    std::size_t next = first;
+    for(std::size_t i = 0; i < length; ++i)
+    {
+        if(is_trail_octet(data[i]))
+            continue;
+
+        if(count == next)
+        {
+            offsets.push_back(i);
+            next += stride;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+#ifdef UNICPP_SIMD_X86
+
+/*
+ * The vectorized validators classify each pair of consecutive octets with three
+ * 16-entry lookup tables (indexed by the high and low nibbles of the previous octet
+ * and by the high nibble of the current one). A bit remaining set after AND-ing the
+ * three results is an error. The 3rd and 4th octets of longer sequences are then
+ * checked against the leads found two and three octets before.
+ *
+ * Unlike strict UTF-8, overlong 3 and 4 octets sequences are accepted because
+ * is_valid_utf8 accepts them, while U+FFFE and U+FFFF are rejected (including their
+ * overlong 4 octets forms).
+ */
+const std::uint8_t TOO_SHORT = 1 << 0; // 11______ 0_______ or 11______ 11______
+const std::uint8_t TOO_LONG = 1 << 1; // 0_______ 10______
+const std::uint8_t TOO_LARGE = 1 << 3; // 11110100 1001____ or 11110100 101_____ (and above)
+const std::uint8_t SURROGATE = 1 << 4; // 11101101 101_____
+const std::uint8_t OVERLONG_2 = 1 << 5; // 1100000_ 10______
+const std::uint8_t TOO_LARGE_1000 = 1 << 6; // 11110101 1000____ (and above)
+const std::uint8_t TWO_CONTS = 1 << 7; // 10______ 10______
+const std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define UNICPP_BYTE_1_HIGH_TABLE \
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, \
+    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, \
+    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS, \
+    TOO_SHORT | OVERLONG_2, \
+    TOO_SHORT, \
+    TOO_SHORT | SURROGATE, \
+    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000
+
+#define UNICPP_BYTE_1_LOW_TABLE \
+    CARRY | OVERLONG_2, \
+    CARRY | OVERLONG_2, \
+    CARRY, \
+    CARRY, \
+    CARRY | TOO_LARGE, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000, \
+    CARRY | TOO_LARGE | TOO_LARGE_1000
+
+#define UNICPP_BYTE_2_HIGH_TABLE \
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, \
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | TOO_LARGE_1000, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | TOO_LARGE, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, \
+    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+
+// ---- SSE4.2 (16 octets per vector, 4 vectors per step) ----
+
+struct sse42_state
+{
+    __m128i error;
+    __m128i prev_input;
+    __m128i prev_incomplete;
+};
+
+template<int N>
+UNICPP_TARGET_SSE42 inline __m128i sse42_prev(__m128i input, __m128i prev_input)
+{
+    return _mm_alignr_epi8(input, prev_input, 16 - N);
+}
+
+UNICPP_TARGET_SSE42 inline __m128i sse42_eq(__m128i input, unsigned char value)
+{
+    return _mm_cmpeq_epi8(input, _mm_set1_epi8(static_cast<char>(value)));
+}
+
+UNICPP_TARGET_SSE42 inline __m128i sse42_high_nibble(__m128i input)
+{
+    return _mm_and_si128(_mm_srli_epi16(input, 4), _mm_set1_epi8(0x0F));
+}
+
+UNICPP_TARGET_SSE42 inline void sse42_check_vector(sse42_state& state, __m128i input)
+{
+    const __m128i prev1 = sse42_prev<1>(input, state.prev_input);
+    const __m128i prev2 = sse42_prev<2>(input, state.prev_input);
+    const __m128i prev3 = sse42_prev<3>(input, state.prev_input);
+
+    const __m128i byte_1_high = _mm_shuffle_epi8(_mm_setr_epi8(UNICPP_BYTE_1_HIGH_TABLE), sse42_high_nibble(prev1));
+    const __m128i byte_1_low = _mm_shuffle_epi8(_mm_setr_epi8(UNICPP_BYTE_1_LOW_TABLE), _mm_and_si128(prev1, _mm_set1_epi8(0x0F)));
+    const __m128i byte_2_high = _mm_shuffle_epi8(_mm_setr_epi8(UNICPP_BYTE_2_HIGH_TABLE), sse42_high_nibble(input));
+    const __m128i special_cases = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // Only 111_____ (resp. 1111____) leads require a continuation two (resp. three) octets later
+    const __m128i is_third_byte = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m128i is_fourth_byte = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m128i must23_80 = _mm_and_si128(_mm_or_si128(is_third_byte, is_fourth_byte), _mm_set1_epi8(static_cast<char>(0x80)));
+
+    // U+FFFE and U+FFFF (EF BF BE|BF and the overlong F0 8F BF BE|BF) and overlong surrogates (F0 8D A0..BF)
+    const __m128i noncharacter = _mm_and_si128(
+        _mm_and_si128(sse42_eq(prev1, 0xBF), sse42_eq(_mm_or_si128(input, _mm_set1_epi8(0x01)), 0xBF)),
+        _mm_or_si128(sse42_eq(prev2, 0xEF), _mm_and_si128(sse42_eq(prev2, 0x8F), sse42_eq(prev3, 0xF0))));
+    const __m128i overlong_surrogate = _mm_and_si128(
+        _mm_and_si128(sse42_eq(prev2, 0xF0), sse42_eq(prev1, 0x8D)),
+        sse42_eq(_mm_and_si128(input, _mm_set1_epi8(static_cast<char>(0xE0))), 0xA0));
+
+    state.error = _mm_or_si128(state.error, _mm_xor_si128(must23_80, special_cases));
+    state.error = _mm_or_si128(state.error, _mm_or_si128(noncharacter, overlong_surrogate));
+    state.prev_input = input;
+}
+
+UNICPP_TARGET_SSE42 inline void sse42_check_block(sse42_state& state, const unsigned char* block)
+{
+    const __m128i in0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const __m128i in1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    const __m128i in2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+    const __m128i in3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+
+    if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(in0, in1), _mm_or_si128(in2, in3))) == 0)
+    {
+        // Only ASCII: the block is valid if no sequence was left unfinished before it
+        state.error = _mm_or_si128(state.error, state.prev_incomplete);
+        state.prev_input = in3;
+        state.prev_incomplete = _mm_setzero_si128();
+        return;
+    }
+
+    sse42_check_vector(state, in0);
+    sse42_check_vector(state, in1);
+    sse42_check_vector(state, in2);
+    sse42_check_vector(state, in3);
+
+    // Leads too close to the end of the block to be complete
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    state.prev_incomplete = _mm_subs_epu8(in3, max_value);
+}
+
+UNICPP_TARGET_SSE42 bool validate_utf8_sse42(const unsigned char* data, std::size_t length)
+{
+    sse42_state state;
+    state.error = _mm_setzero_si128();
+    state.prev_input = _mm_setzero_si128();
+    state.prev_incomplete = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+        sse42_check_block(state, data + i);
+
+    if(i < length)
+    {
+        unsigned char last_block[64] = {0};
+        std::memcpy(last_block, data + i, length - i);
+        sse42_check_block(state, last_block);
+    }
+
+    state.error = _mm_or_si128(state.error, state.prev_incomplete);
+    return _mm_testz_si128(state.error, state.error) != 0;
+}
+
+UNICPP_TARGET_SSE42 std::size_t find_invalid_utf8_sse42(const unsigned char* data, std::size_t length)
+{
+    sse42_state state;
+    state.error = _mm_setzero_si128();
+    state.prev_input = _mm_setzero_si128();
+    state.prev_incomplete = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+    {
+        sse42_check_block(state, data + i);
+        if(!_mm_testz_si128(state.error, state.error))
+            return find_invalid_utf8_from_block(data, length, i);
+    }
+
+    if(i < length)
+    {
+        unsigned char last_block[64] = {0};
+        std::memcpy(last_block, data + i, length - i);
+        sse42_check_block(state, last_block);
+    }
+
+    state.error = _mm_or_si128(state.error, state.prev_incomplete);
+    if(!_mm_testz_si128(state.error, state.error))
+        return find_invalid_utf8_from_block(data, length, i);
+
+    return length;
+}
+
+/**
+ * Appends the offsets of the indexed codepoints of a block of 64 octets, given the mask
+ * of its lead octets. count is the number of codepoints before the block and next the
+ * next codepoint to index, both are updated.
+ */
+inline void index_block(std::uint64_t leads, std::size_t block_offset, std::size_t stride,
+                        std::size_t& count, std::size_t& next, std::vector<std::size_t>& offsets)
+{
+    const std::size_t block_count = __builtin_popcountll(leads);
+    while(next < count + block_count)
+    {
+        std::uint64_t remaining = leads;
+        for(std::size_t skip = next - count; skip > 0; --skip)
+            remaining &= remaining - 1;
+
+        offsets.push_back(block_offset + __builtin_ctzll(remaining));
+        next += stride;
+    }
+
+    count += block_count;
+}
+
+/**
+ * Mask of the lead octets of the last (incomplete) block.
+ */
+inline std::uint64_t tail_leads(const unsigned char* data, std::size_t length)
+{
+    std::uint64_t leads = 0;
+    for(std::size_t i = 0; i < length; ++i)
+    {
+        if(!is_trail_octet(data[i]))
+            leads |= std::uint64_t(1) << i;
+    }
+
+    return leads;
+}
+
+UNICPP_TARGET_SSE42 std::size_t count_utf8_codepoints_sse42(const unsigned char* data, std::size_t length)
+{
+    // Trail octets are the only ones below -64 as signed integers
+    const __m128i last_trail = _mm_set1_epi8(static_cast<char>(0xBF));
+
+    std::size_t count = 0;
+    std::size_t i = 0;
+    while(i + 16 <= length)
+    {
+        // The 8-bit counters are summed before they can overflow
+        __m128i counters = _mm_setzero_si128();
+        for(int n = 0; n < 255 && i + 16 <= length; ++n, i += 16)
+        {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpgt_epi8(input, last_trail));
+        }
+
+        const __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+        count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+    }
+
+    const char* tail = reinterpret_cast<const char*>(data + i);
+    return count + utf32_length_from_utf8(tail, tail + (length - i));
+}
+
+UNICPP_TARGET_SSE42 std::size_t index_utf8_codepoints_sse42(const unsigned char* data, std::size_t length, std::size_t first,
+                                                             std::size_t stride, std::vector<std::size_t>& offsets)
+{
+    const __m128i last_trail = _mm_set1_epi8(static_cast<char>(0xBF));
+
+    std::size_t count = 0;
+    std::size_t next = first;
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+    {
+        std::uint64_t leads = 0;
+        for(int j = 0; j < 4; ++j)
+        {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * j));
+            const std::uint16_t mask = static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(input, last_trail)));
+            leads |= static_cast<std::uint64_t>(mask) << (16 * j);
+        }
+
+        index_block(leads, i, stride, count, next, offsets);
+    }
+
+    index_block(tail_leads(data + i, length - i), i, stride, count, next, offsets);
+    return count;
+}
+
+// ---- AVX2 (32 octets per vector, 2 vectors per step) ----
+
+struct avx2_state
+{
+    __m256i error;
+    __m256i prev_input;
+    __m256i prev_incomplete;
+};
+
+template<int N>
+UNICPP_TARGET_AVX2 inline __m256i avx2_prev(__m256i input, __m256i prev_input)
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev_input, input, 0x21), 16 - N);
+}
+
+UNICPP_TARGET_AVX2 inline __m256i avx2_eq(__m256i input, unsigned char value)
+{
+    return _mm256_cmpeq_epi8(input, _mm256_set1_epi8(static_cast<char>(value)));
+}
+
+UNICPP_TARGET_AVX2 inline __m256i avx2_high_nibble(__m256i input)
+{
+    return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+UNICPP_TARGET_AVX2 inline void avx2_check_vector(avx2_state& state, __m256i input)
+{
+    const __m256i prev1 = avx2_prev<1>(input, state.prev_input);
+    const __m256i prev2 = avx2_prev<2>(input, state.prev_input);
+    const __m256i prev3 = avx2_prev<3>(input, state.prev_input);
+
+    const __m256i byte_1_high = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UNICPP_BYTE_1_HIGH_TABLE, UNICPP_BYTE_1_HIGH_TABLE), avx2_high_nibble(prev1));
+    const __m256i byte_1_low = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UNICPP_BYTE_1_LOW_TABLE, UNICPP_BYTE_1_LOW_TABLE), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+    const __m256i byte_2_high = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UNICPP_BYTE_2_HIGH_TABLE, UNICPP_BYTE_2_HIGH_TABLE), avx2_high_nibble(input));
+    const __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    const __m256i is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    const __m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    const __m256i must23_80 = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+    const __m256i noncharacter = _mm256_and_si256(
+        _mm256_and_si256(avx2_eq(prev1, 0xBF), avx2_eq(_mm256_or_si256(input, _mm256_set1_epi8(0x01)), 0xBF)),
+        _mm256_or_si256(avx2_eq(prev2, 0xEF), _mm256_and_si256(avx2_eq(prev2, 0x8F), avx2_eq(prev3, 0xF0))));
+    const __m256i overlong_surrogate = _mm256_and_si256(
+        _mm256_and_si256(avx2_eq(prev2, 0xF0), avx2_eq(prev1, 0x8D)),
+        avx2_eq(_mm256_and_si256(input, _mm256_set1_epi8(static_cast<char>(0xE0))), 0xA0));
+
+    state.error = _mm256_or_si256(state.error, _mm256_xor_si256(must23_80, special_cases));
+    state.error = _mm256_or_si256(state.error, _mm256_or_si256(noncharacter, overlong_surrogate));
+    state.prev_input = input;
+}
+
+UNICPP_TARGET_AVX2 inline void avx2_check_block(avx2_state& state, const unsigned char* block)
+{
+    const __m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i in1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    if(_mm256_movemask_epi8(_mm256_or_si256(in0, in1)) == 0)
+    {
+        state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+        state.prev_input = in1;
+        state.prev_incomplete = _mm256_setzero_si256();
+        return;
+    }
+
+    avx2_check_vector(state, in0);
+    avx2_check_vector(state, in1);
+
+    const __m256i max_value = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    state.prev_incomplete = _mm256_subs_epu8(in1, max_value);
+}
+
+UNICPP_TARGET_AVX2 bool validate_utf8_avx2(const unsigned char* data, std::size_t length)
+{
+    avx2_state state;
+    state.error = _mm256_setzero_si256();
+    state.prev_input = _mm256_setzero_si256();
+    state.prev_incomplete = _mm256_setzero_si256();
+
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+        avx2_check_block(state, data + i);
+
+    if(i < length)
+    {
+        unsigned char last_block[64] = {0};
+        std::memcpy(last_block, data + i, length - i);
+        avx2_check_block(state, last_block);
+    }
+
+    state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+    return _mm256_testz_si256(state.error, state.error) != 0;
+}
+
+UNICPP_TARGET_AVX2 std::size_t find_invalid_utf8_avx2(const unsigned char* data, std::size_t length)
+{
+    avx2_state state;
+    state.error = _mm256_setzero_si256();
+    state.prev_input = _mm256_setzero_si256();
+    state.prev_incomplete = _mm256_setzero_si256();
+
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+    {
+        avx2_check_block(state, data + i);
+        if(!_mm256_testz_si256(state.error, state.error))
+            return find_invalid_utf8_from_block(data, length, i);
+    }
+
+    if(i < length)
+    {
+        unsigned char last_block[64] = {0};
+        std::memcpy(last_block, data + i, length - i);
+        avx2_check_block(state, last_block);
+    }
+
+    state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+    if(!_mm256_testz_si256(state.error, state.error))
+        return find_invalid_utf8_from_block(data, length, i);
+
+    return length;
+}
+
+UNICPP_TARGET_AVX2 std::size_t count_utf8_codepoints_avx2(const unsigned char* data, std::size_t length)
+{
+    const __m256i last_trail = _mm256_set1_epi8(static_cast<char>(0xBF));
+
+    std::size_t count = 0;
+    std::size_t i = 0;
+    while(i + 32 <= length)
+    {
+        __m256i counters = _mm256_setzero_si256();
+        for(int n = 0; n < 255 && i + 32 <= length; ++n, i += 32)
+        {
+            const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpgt_epi8(input, last_trail));
+        }
+
+        const __m256i sums = _mm256_sad_epu8(counters, _mm256_setzero_si256());
+        const __m128i half_sums = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        count += _mm_cvtsi128_si32(half_sums) + _mm_extract_epi16(half_sums, 4);
+    }
+
+    const char* tail = reinterpret_cast<const char*>(data + i);
+    return count + utf32_length_from_utf8(tail, tail + (length - i));
+}
+
+UNICPP_TARGET_AVX2 std::size_t index_utf8_codepoints_avx2(const unsigned char* data, std::size_t length, std::size_t first,
+                                                           std::size_t stride, std::vector<std::size_t>& offsets)
+{
+    const __m256i last_trail = _mm256_set1_epi8(static_cast<char>(0xBF));
+
+    std::size_t count = 0;
+    std::size_t next = first;
+    std::size_t i = 0;
+    for(; i + 64 <= length; i += 64)
+    {
+        const __m256i in0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i in1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        const std::uint32_t mask0 = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(in0, last_trail)));
+        const std::uint32_t mask1 = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(in1, last_trail)));
+
+        index_block(mask0 | (static_cast<std::uint64_t>(mask1) << 32), i, stride, count, next, offsets);
+    }
+
+    index_block(tail_leads(data + i, length - i), i, stride, count, next, offsets);
+    return count;
+}
+
+#undef UNICPP_BYTE_1_HIGH_TABLE
+#undef UNICPP_BYTE_1_LOW_TABLE
+#undef UNICPP_BYTE_2_HIGH_TABLE
+
+#endif
+
+simd_level detect_simd_level()
+{
+#ifdef UNICPP_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return simd_level::avx2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return simd_level::sse42;
+#endif
+    return simd_level::scalar;
+}
+
+}
+
+simd_level get_simd_level()
+{
+    static const simd_level level = detect_simd_level();
+    return level;
+}
+
+bool validate_utf8(const char* data, std::size_t length)
+{
+    return validate_utf8(data, length, get_simd_level());
+}
+
+bool validate_utf8(const char* data, std::size_t length, simd_level level)
+{
+    const unsigned char* octets = reinterpret_cast<const unsigned char*>(data);
+
+#ifdef UNICPP_SIMD_X86
+    if(level == simd_level::avx2)
+        return validate_utf8_avx2(octets, length);
+    if(level == simd_level::sse42)
+        return validate_utf8_sse42(octets, length);
+#endif
+
+    return validate_utf8_scalar(octets, octets + length);
+}
+
+std::size_t find_invalid_utf8(const char* data, std::size_t length)
+{
+    return find_invalid_utf8(data, length, get_simd_level());
+}
+
+std::size_t find_invalid_utf8(const char* data, std::size_t length, simd_level level)
+{
+    const unsigned char* octets = reinterpret_cast<const unsigned char*>(data);
+
+#ifdef UNICPP_SIMD_X86
+    if(level == simd_level::avx2)
+        return find_invalid_utf8_avx2(octets, length);
+    if(level == simd_level::sse42)
+        return find_invalid_utf8_sse42(octets, length);
+#endif
+
+    return find_invalid_utf8_scalar(octets, octets + length) - octets;
+}
+
+std::size_t count_utf8_codepoints(const char* data, std::size_t length)
+{
+    return count_utf8_codepoints(data, length, get_simd_level());
+}
+
+std::size_t count_utf8_codepoints(const char* data, std::size_t length, simd_level level)
+{
+#ifdef UNICPP_SIMD_X86
+    const unsigned char* octets = reinterpret_cast<const unsigned char*>(data);
+
+    if(level == simd_level::avx2)
+        return count_utf8_codepoints_avx2(octets, length);
+    if(level == simd_level::sse42)
+        return count_utf8_codepoints_sse42(octets, length);
+#endif
+
+    return utf32_length_from_utf8(data, data + length);
+}
+
+std::size_t index_utf8_codepoints(const char* data, std::size_t length, std::size_t first, std::size_t stride, std::vector<std::size_t>& offsets)
+{
+    return index_utf8_codepoints(data, length, first, stride, offsets, get_simd_level());
+}
+
+std::size_t index_utf8_codepoints(const char* data, std::size_t length, std::size_t first, std::size_t stride,
+                                  std::vector<std::size_t>& offsets, simd_level level)
+{
+    const unsigned char* octets = reinterpret_cast<const unsigned char*>(data);
+
+#ifdef UNICPP_SIMD_X86
+    if(level == simd_level::avx2)
+        return index_utf8_codepoints_avx2(octets, length, first, stride, offsets);
+    if(level == simd_level::sse42)
+        return index_utf8_codepoints_sse42(octets, length, first, stride, offsets);
+#endif
+
+    return index_utf8_codepoints_scalar(octets, length, first, stride, offsets);
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef UNICPP_UTF8SIMD_H
+#define UNICPP_UTF8SIMD_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * \file Contains the vectorized kernels working on contiguous UTF-8 buffers.
+ * The best implementation supported by the CPU is selected at runtime, the
+ * scalar versions are always available and are used as a fallback.
+ * Used internally by unicpp::string.
+ */
+
+namespace unicpp
+{
+
+/**
+ * Instruction sets that the kernels can be dispatched to, from the slowest
+ * to the fastest.
+ */
+enum class simd_level
+{
+    scalar,
+    sse42,
+    avx2
+};
+
+/**
+ * Returns the best instruction set supported by the running CPU (and
+ * by the compiler that built the library).
+ */
+simd_level get_simd_level();
+
+/**
+ * Returns true if the buffer contains valid UTF-8, using exactly the same rules
+ * as is_valid_utf8 (see is_valid_utf8_octet and is_valid_codepoint).
+ */
+bool validate_utf8(const char* data, std::size_t length);
+
+/**
+ * Same as validate_utf8 but forces the implementation to use.
+ * The level must be supported by the CPU (see get_simd_level()).
+ */
+bool validate_utf8(const char* data, std::size_t length, simd_level level);
+
+/**
+ * Returns the offset of the first octet of the first invalid sequence
+ * (where iterate_next would throw), or length if the buffer is valid.
+ */
+std::size_t find_invalid_utf8(const char* data, std::size_t length);
+
+/**
+ * Same as find_invalid_utf8 but forces the implementation to use.
+ */
+std::size_t find_invalid_utf8(const char* data, std::size_t length, simd_level level);
+
+/**
+ * Returns the number of codepoints of a valid UTF-8 buffer, that is the number of
+ * octets which are not continuation octets. The result is meaningless if the
+ * buffer is not valid (see validate_utf8).
+ */
+std::size_t count_utf8_codepoints(const char* data, std::size_t length);
+
+/**
+ * Same as count_utf8_codepoints but forces the implementation to use.
+ */
+std::size_t count_utf8_codepoints(const char* data, std::size_t length, simd_level level);
+
+/**
+ * Appends to offsets the offset of the codepoints first, first + stride, first + 2 * stride...
+ * of a valid UTF-8 buffer and returns its number of codepoints.
+ * As for count_utf8_codepoints, the result is meaningless if the buffer is not valid.
+ */
+std::size_t index_utf8_codepoints(const char* data, std::size_t length, std::size_t first, std::size_t stride, std::vector<std::size_t>& offsets);
+
+/**
+ * Same as index_utf8_codepoints but forces the implementation to use.
+ */
+std::size_t index_utf8_codepoints(const char* data, std::size_t length, std::size_t first, std::size_t stride, std::vector<std::size_t>& offsets, simd_level level);
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include "Utf8Stream.hpp"
+
+#include <cstring>
+
+#include "Utf8Transcode.hpp"
+
+namespace unicpp
+{
+
+utf8_stream_decoder::utf8_stream_decoder() :
+    utf8_stream_decoder(get_simd_level())
+{
+}
+
+utf8_stream_decoder::utf8_stream_decoder(simd_level level) :
+    m_level(level)
+{
+    reset();
+}
+
+bool utf8_stream_decoder::validate(const char* data, std::size_t length)
+{
+    const char* it = data;
+    const char* end = data + length;
+    char32_t* no_output = nullptr;
+
+    if(begin_chunk(it, end, no_output))
+        end_chunk(it, end);
+
+    return m_status == utf8_status::ok;
+}
+
+char32_t* utf8_stream_decoder::decode(const char* data, std::size_t length, char32_t* output)
+{
+    const char* it = data;
+    const char* end = data + length;
+
+    if(!begin_chunk(it, end, output))
+        return output;
+
+    // The valid part of the chunk is only decoded, not checked again
+    const char* valid_end = end_chunk(it, end);
+    return transcode_valid_utf8_to_utf32(it, valid_end, output, m_level);
+}
+
+bool utf8_stream_decoder::finish()
+{
+    if(m_status == utf8_status::ok && m_pending_length > 0)
+        fail(utf8_status::truncated_sequence, m_position - m_pending_length);
+
+    return m_status == utf8_status::ok;
+}
+
+void utf8_stream_decoder::reset()
+{
+    m_status = utf8_status::ok;
+    m_error_offset = 0;
+    m_pending_length = 0;
+    m_position = 0;
+}
+
+utf8_status utf8_stream_decoder::status() const
+{
+    return m_status;
+}
+
+std::uint64_t utf8_stream_decoder::error_offset() const
+{
+    return m_error_offset;
+}
+
+std::uint64_t utf8_stream_decoder::position() const
+{
+    return m_position;
+}
+
+/**
+ * Completes the sequence cut by the end of the previous chunk, writing its codepoint to output
+ * (unless it is null). Returns false if there is nothing else to do with the chunk.
+ */
+bool utf8_stream_decoder::begin_chunk(const char*& it, const char* end, char32_t*& output)
+{
+    const std::size_t length = end - it;
+    const std::uint64_t chunk_offset = m_position;
+    m_position += length;
+
+    // An empty chunk may come without any buffer
+    if(m_status != utf8_status::ok || length == 0)
+        return false;
+    if(m_pending_length == 0)
+        return true;
+
+    utf8_cut_sequence_result cut = complete_cut_sequence(m_pending, m_pending_length, reinterpret_cast<const unsigned char*>(it), length);
+    if(cut.incomplete)
+        return false;
+    if(cut.decoded.status != utf8_status::ok)
+    {
+        fail(cut.decoded.status, chunk_offset - m_pending_length);
+        return false;
+    }
+
+    if(output)
+        *output++ = cut.decoded.codepoint;
+
+    it += cut.chunk_octets;
+    m_pending_length = 0;
+    return true;
+}
+
+/**
+ * Validates the rest of the chunk, and returns the end of its valid part. A sequence only cut
+ * by the end of the chunk is kept for the next one.
+ */
+const char* utf8_stream_decoder::end_chunk(const char* it, const char* end)
+{
+    const char* valid_end = it + find_invalid_utf8(it, end - it, m_level);
+    if(valid_end == end)
+        return end;
+
+    const unsigned char* sequence = reinterpret_cast<const unsigned char*>(valid_end);
+    const unsigned char* octets_end = reinterpret_cast<const unsigned char*>(end);
+    utf8_decode_result result = decode_next(sequence, octets_end);
+
+    if(result.status == utf8_status::truncated_sequence && sequence == octets_end)
+    {
+        m_pending_length = end - valid_end;
+        std::memcpy(m_pending, valid_end, m_pending_length);
+    }
+    else
+        fail(result.status, m_position - (end - valid_end));
+
+    return valid_end;
+}
+
+void utf8_stream_decoder::fail(utf8_status status, std::uint64_t offset)
+{
+    m_status = status;
+    m_error_offset = offset;
+    m_pending_length = 0;
+}
+
+}
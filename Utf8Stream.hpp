@@ -0,0 +1,96 @@
+#ifndef UNICPP_UTF8STREAM_H
+#define UNICPP_UTF8STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Utf8Simd.hpp"
+#include "Utf8Tools.hpp"
+
+namespace unicpp
+{
+
+/**
+ * Incremental validation and decoding of a UTF-8 stream received in chunks of any size,
+ * such as the buffers of a socket or of a file read piece by piece.
+ *
+ * Inside a chunk, the vectorized validator and decoder are used. Only the octets of a sequence
+ * cut by the end of a chunk (3 at most) are kept until the next one, so the results are the
+ * same as with the whole stream in a single buffer, wherever it is cut.
+ *
+ * The decoder does not throw: the first error stops it and is kept, with its offset from the
+ * beginning of the stream, until reset().
+ */
+class utf8_stream_decoder
+{
+public:
+    utf8_stream_decoder();
+
+    /**
+     * Same as utf8_stream_decoder() but forces the implementation to use.
+     */
+    explicit utf8_stream_decoder(simd_level level);
+
+    /**
+     * Validates the next chunk of the stream. Returns false if the stream is invalid (see
+     * status()), the following chunks are then ignored.
+     */
+    bool validate(const char* data, std::size_t length);
+
+    /**
+     * Decodes the next chunk of the stream to output, and returns the end of the output.
+     * On an error, the codepoints before it are still written (see status()).
+     *
+     * output must be able to hold length codepoints: the vectorized stores may write after
+     * the returned end, in that space.
+     */
+    char32_t* decode(const char* data, std::size_t length, char32_t* output);
+
+    /**
+     * Ends the stream. Returns false if the stream is invalid, including when it ends with
+     * an incomplete sequence (utf8_status::truncated_sequence).
+     */
+    bool finish();
+
+    /**
+     * Forgets the current stream, and its error.
+     */
+    void reset();
+
+    /**
+     * Returns utf8_status::ok, or the error of the first invalid sequence of the stream.
+     */
+    utf8_status status() const;
+
+    /**
+     * Returns the offset (from the beginning of the stream) of the first octet of the first
+     * invalid sequence, the same as find_invalid_utf8 with the whole stream.
+     * Only meaningful if status() is not utf8_status::ok.
+     */
+    std::uint64_t error_offset() const;
+
+    /**
+     * Returns the number of octets fed since the beginning of the stream.
+     */
+    std::uint64_t position() const;
+
+private:
+    bool begin_chunk(const char*& it, const char* end, char32_t*& output);
+    const char* end_chunk(const char* it, const char* end);
+    void fail(utf8_status status, std::uint64_t offset);
+
+    simd_level m_level;
+
+    utf8_status m_status;
+    std::uint64_t m_error_offset;
+
+    // Octets of the sequence cut by the end of the last chunk
+    unsigned char m_pending[4];
+    std::size_t m_pending_length;
+
+    std::uint64_t m_position;
+};
+
+}
+
+#endif
@@ -1,58 +1,33 @@
 #include "Utf8Tools.hpp"
 
-namespace unicpp
-{
-
-bool is_valid_utf8_octet(unsigned char octet)
-{
-    return octet != 0xC0 && octet != 0xC1 && octet != 0xF5 && octet != 0xFF;
-}
-
-bool is_valid_codepoint(char32_t codepoint)
-{
-    return codepoint <= CODE_POINT_MAX &&
-        !is_utf16_surrogate(static_cast<char16_t>(codepoint)) &&
-        codepoint != 0xffff &&
-        codepoint != 0xfffe;
-}
-
-bool is_utf16_lead_surrogate(char16_t codeunit)
-{
-    return codeunit >= LEAD_SURROGATE_MIN && codeunit <= LEAD_SURROGATE_MAX;
-}
+#include <string>
 
-bool is_utf16_trail_surrogate(char16_t codeunit)
-{
-    return codeunit >= TRAIL_SURROGATE_MIN && codeunit <= TRAIL_SURROGATE_MAX;
-}
-
-bool is_utf16_surrogate(char16_t codeunit)
+namespace unicpp
 {
-    return is_utf16_lead_surrogate(codeunit) || is_utf16_trail_surrogate(codeunit);
-}
 
-bool is_lead_octet(unsigned char octet)
-{
-    return get_lead_octet_sequence_length(octet) != 0;
-}
+// The predicates and the decoder index the tables at runtime, so they need a definition
+constexpr std::uint8_t utf8_octet_table::PROPERTIES[256];
+constexpr std::uint8_t utf8_dfa_table::OCTET_CLASSES[256];
+constexpr std::uint8_t utf8_dfa_table::LEAD_MASKS[UTF8_DFA_CLASSES_COUNT];
+constexpr std::uint8_t utf8_dfa_table::TRANSITIONS[14 * UTF8_DFA_CLASSES_COUNT];
 
-std::size_t get_lead_octet_sequence_length(unsigned char octet)
+void throw_utf8_error(const utf8_decode_result& result, unsigned char lead_octet)
 {
-    if(octet <= 127) // This is a 1 byte sequence
-        return 1;
-    else if((octet >> 5) == 0x6) // This is a 2 bytes sequence
-        return 2;
-    else if((octet >> 4) == 0xE) // This is a 3 bytes sequence
-        return 3;
-    else if((octet >> 3) == 0x1E) // This is a 4 bytes sequence
-        return 4;
-    else
-        return 0;
+    switch(result.status)
+    {
+    case utf8_status::end_of_range:
+        throw bad_utf8_sequence_exception("Already at the end of the range!");
+    case utf8_status::invalid_octet:
+        throw invalid_utf8_exception(std::to_string(lead_octet) + " is not a valid UTF8 octet!");
+    case utf8_status::bad_lead_octet:
+        throw bad_utf8_sequence_exception("Bad head of sequence octet!");
+    case utf8_status::truncated_sequence:
+        throw bad_utf8_sequence_exception("Not enough octets in a sequence: " + std::to_string(result.length) + " found but " + std::to_string(get_lead_octet_sequence_length(lead_octet)) + " expected!");
+    case utf8_status::invalid_codepoint:
+        throw invalid_codepoint_exception("This is an invalid codepoint: " + std::to_string(result.codepoint));
+    default:
+        break;
+    }
 }
 
-bool is_trail_octet(unsigned char octet)
-{
-    return ((octet >> 6) == 0x2);
 }
-
-}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef UNICPP_UTF8TOOLS_H
 #define UNICPP_UTF8TOOLS_H
 
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
 #include "Exceptions.hpp"
 
 /**
@@ -18,8 +22,251 @@ const char16_t TRAIL_SURROGATE_MAX = 0xdfffu;
 
 const char32_t CODE_POINT_MAX = 0x0010ffffu;
 
-bool is_valid_utf8_octet(unsigned char octet);
-bool is_valid_codepoint(char32_t codepoint);
+const char32_t REPLACEMENT_CHARACTER = 0xfffdu;
+
+/**
+ * Properties of each octet: the UTF8_OCTET_* flags below and, for lead octets,
+ * the length of the sequence they start minus one (so that it obviously fits in 1..4).
+ *
+ * A static member (defined in Utf8Tools.cpp) rather than a namespace scope array, which
+ * would be a different object in every translation unit using the inline predicates.
+ */
+struct utf8_octet_table
+{
+    static constexpr std::uint8_t PROPERTIES[256] = {
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+        0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+        0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+        0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08,
+        0x15, 0x15, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+        0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+        0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+        0x07, 0x07, 0x07, 0x07, 0x07, 0x17, 0x07, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+    };
+};
+
+const std::uint8_t UTF8_OCTET_LENGTH_MASK = 0x03;
+const std::uint8_t UTF8_OCTET_LEAD = 0x04;
+const std::uint8_t UTF8_OCTET_TRAIL = 0x08;
+const std::uint8_t UTF8_OCTET_INVALID = 0x10;
+
+constexpr bool is_valid_utf8_octet(unsigned char octet)
+{
+    return (utf8_octet_table::PROPERTIES[octet] & UTF8_OCTET_INVALID) == 0;
+}
+
+constexpr bool is_valid_codepoint(char32_t codepoint)
+{
+    return codepoint <= CODE_POINT_MAX &&
+        !(codepoint >= LEAD_SURROGATE_MIN && codepoint <= TRAIL_SURROGATE_MAX) &&
+        codepoint != 0xffff &&
+        codepoint != 0xfffe;
+}
+
+/**
+ * Returns true if the code unit (of any UTF encoding) is an ASCII character.
+ */
+template<typename CodeUnit>
+bool is_ascii(CodeUnit codeunit)
+{
+    // Negative values of signed code units (char) become large values
+    return static_cast<std::uint32_t>(codeunit) < 0x80;
+}
+
+/**
+ * Returns the number of ASCII code units at the beginning of the range (which is read
+ * without being consumed, so it must be a forward range).
+ * The overloads for contiguous ranges (pointers) check a 64-bit word at once.
+ */
+template<typename ForwardIterator>
+std::size_t ascii_run_length(ForwardIterator begin, ForwardIterator end)
+{
+    std::size_t length = 0;
+    for(auto it = begin; it != end && is_ascii(*it); ++it)
+        ++length;
+
+    return length;
+}
+
+template<typename CodeUnit>
+std::size_t ascii_run_length(const CodeUnit* begin, const CodeUnit* end, std::uint64_t non_ascii_mask)
+{
+    const std::size_t units_per_word = sizeof(std::uint64_t) / sizeof(CodeUnit);
+
+    const CodeUnit* it = begin;
+    while(static_cast<std::size_t>(end - it) >= units_per_word)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, it, sizeof(word));
+        if(word & non_ascii_mask)
+            break;
+
+        it += units_per_word;
+    }
+
+    while(it != end && is_ascii(*it))
+        ++it;
+
+    return it - begin;
+}
+
+inline std::size_t ascii_run_length(const char* begin, const char* end)
+{
+    return ascii_run_length(begin, end, 0x8080808080808080ull);
+}
+
+inline std::size_t ascii_run_length(const char16_t* begin, const char16_t* end)
+{
+    return ascii_run_length(begin, end, 0xFF80FF80FF80FF80ull);
+}
+
+inline std::size_t ascii_run_length(const char32_t* begin, const char32_t* end)
+{
+    return ascii_run_length(begin, end, 0xFFFFFF80FFFFFF80ull);
+}
+
+inline std::size_t ascii_run_length(const wchar_t* begin, const wchar_t* end)
+{
+    return ascii_run_length(begin, end, sizeof(wchar_t) == 4 ? 0xFFFFFF80FFFFFF80ull : 0xFF80FF80FF80FF80ull);
+}
+
+/**
+ * Writes the ASCII code units at the beginning of [it, end) to output, as OutputUnit (char to
+ * narrow them to UTF-8, unsigned char to widen them from UTF-8), and moves it past them.
+ * Each code unit is only read once, so any input iterator can be used.
+ */
+template<typename OutputUnit, typename InputIterator, typename OutputIterator>
+OutputIterator copy_ascii_run(InputIterator & it, InputIterator end, OutputIterator output)
+{
+    for(; it != end && is_ascii(*it); ++it)
+        *(output++) = static_cast<OutputUnit>(*it);
+
+    return output;
+}
+
+/**
+ * Same as above for contiguous ranges, where the run is found a word at a time first.
+ */
+template<typename OutputUnit, typename CodeUnit, typename OutputIterator>
+OutputIterator copy_ascii_run(CodeUnit* & it, CodeUnit* end, OutputIterator output)
+{
+    for(std::size_t ascii = ascii_run_length(static_cast<const CodeUnit*>(it), static_cast<const CodeUnit*>(end)); ascii > 0; --ascii, ++it)
+        *(output++) = static_cast<OutputUnit>(*it);
+
+    return output;
+}
+
+/**
+ * Returns the number of bits set in a word where only the high bit of each octet may be set.
+ */
+inline std::size_t count_octets_high_bits(std::uint64_t bits)
+{
+    return static_cast<std::size_t>(((bits >> 7) * 0x0101010101010101ull) >> 56);
+}
+
+/*
+ * The *_length_from_* functions compute the number of code units written by the
+ * converters. They are exact for valid input and an upper bound of what the
+ * (throwing) converters write before failing otherwise, so that the output can
+ * be preallocated once.
+ */
+
+/**
+ * Number of char32_t written by utf8_to_utf32, i.e. the number of octets that are not trail octets.
+ */
+inline std::size_t utf32_length_from_utf8(const char* begin, const char* end)
+{
+    const std::uint64_t high_bits = 0x8080808080808080ull;
+
+    std::size_t length = 0;
+    const char* it = begin;
+    for(; end - it >= 8; it += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, it, sizeof(word));
+        std::uint64_t trail_octets = word & ~(word << 1) & high_bits; // 10xxxxxx
+        length += 8 - count_octets_high_bits(trail_octets);
+    }
+
+    for(; it != end; ++it)
+    {
+        if((static_cast<unsigned char>(*it) & 0xC0) != 0x80)
+            ++length;
+    }
+
+    return length;
+}
+
+/**
+ * Number of char16_t written by utf8_to_utf16: one per sequence, plus one per 4 octets sequence (surrogate pair).
+ */
+inline std::size_t utf16_length_from_utf8(const char* begin, const char* end)
+{
+    const std::uint64_t high_bits = 0x8080808080808080ull;
+
+    std::size_t length = 0;
+    const char* it = begin;
+    for(; end - it >= 8; it += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, it, sizeof(word));
+        std::uint64_t trail_octets = word & ~(word << 1) & high_bits; // 10xxxxxx
+        std::uint64_t four_octets_leads = word & (word << 1) & (word << 2) & (word << 3) & high_bits; // 1111xxxx
+        length += 8 - count_octets_high_bits(trail_octets) + count_octets_high_bits(four_octets_leads);
+    }
+
+    for(; it != end; ++it)
+    {
+        unsigned char octet = static_cast<unsigned char>(*it);
+        if((octet & 0xC0) != 0x80)
+            ++length;
+        if(octet >= 0xF0)
+            ++length;
+    }
+
+    return length;
+}
+
+/**
+ * Number of char written by utf32_to_utf8 (CodeUnit is char32_t, or wchar_t where it holds UTF-32).
+ */
+template<typename CodeUnit>
+std::size_t utf8_length_from_utf32(const CodeUnit* begin, const CodeUnit* end)
+{
+    std::size_t length = 0;
+    for(auto it = begin; it != end; ++it)
+    {
+        char32_t codepoint = static_cast<char32_t>(*it);
+        length += 1 + (codepoint > 0x7F) + (codepoint > 0x7FF) + (codepoint > 0xFFFF);
+    }
+
+    return length;
+}
+
+/**
+ * Number of char written by utf16_to_utf8 (a surrogate pair gives 4 octets, 2 per surrogate).
+ * CodeUnit is char16_t, or wchar_t where it holds UTF-16.
+ */
+template<typename CodeUnit>
+std::size_t utf8_length_from_utf16(const CodeUnit* begin, const CodeUnit* end)
+{
+    std::size_t length = 0;
+    for(auto it = begin; it != end; ++it)
+    {
+        char16_t codeunit = static_cast<char16_t>(*it);
+        length += 1 + (codeunit > 0x7F) + (codeunit > 0x7FF && (codeunit < LEAD_SURROGATE_MIN || codeunit > TRAIL_SURROGATE_MAX));
+    }
+
+    return length;
+}
 
 /**
     * Convert a utf32 codeunit (representing a single codepoint) to
@@ -30,7 +277,7 @@ bool is_valid_codepoint(char32_t codepoint);
 template<typename OutputIterator>
 OutputIterator codepoint_to_utf8(char32_t codepoint, OutputIterator output)
 {
-    if(!is_valid_codepoint(codepoint))
+    if(codepoint > 0x0000007F && !is_valid_codepoint(codepoint)) // ASCII codepoints are always valid
         throw invalid_codepoint_exception("This codepoint is invalid: " + std::to_string(codepoint));
 
     if(codepoint <= 0x0000007F)
@@ -88,19 +335,35 @@ OutputIterator codepoint_to_utf8(char32_t codepoint, OutputIterator output)
 template<typename InputIterator, typename OutputIterator>
 OutputIterator utf32_to_utf8(InputIterator begin, InputIterator end, OutputIterator output)
 {
-    for(auto it = begin; it != end; ++it)
+    for(auto it = begin; it != end; )
     {
+        // ASCII runs are narrowed without any check
+        output = copy_ascii_run<char>(it, end, output);
+
+        if(it == end)
+            break;
+
         output = codepoint_to_utf8<OutputIterator>(*it, output);
+        ++it;
     }
 
     return output;
 }
 
-bool is_utf16_lead_surrogate(char16_t codeunit);
+constexpr bool is_utf16_lead_surrogate(char16_t codeunit)
+{
+    return codeunit >= LEAD_SURROGATE_MIN && codeunit <= LEAD_SURROGATE_MAX;
+}
 
-bool is_utf16_trail_surrogate(char16_t codeunit);
+constexpr bool is_utf16_trail_surrogate(char16_t codeunit)
+{
+    return codeunit >= TRAIL_SURROGATE_MIN && codeunit <= TRAIL_SURROGATE_MAX;
+}
 
-bool is_utf16_surrogate(char16_t codeunit);
+constexpr bool is_utf16_surrogate(char16_t codeunit)
+{
+    return codeunit >= LEAD_SURROGATE_MIN && codeunit <= TRAIL_SURROGATE_MAX;
+}
 
 template<typename InputIterator, typename OutputIterator>
 OutputIterator utf16_character_to_utf8(InputIterator & it, InputIterator end, OutputIterator output)
@@ -139,113 +402,578 @@ OutputIterator utf16_to_utf8(InputIterator begin, InputIterator end, OutputItera
 {
     for(auto it = begin; it != end; )
     {
+        output = copy_ascii_run<char>(it, end, output);
+
+        if(it == end)
+            break;
+
         output = utf16_character_to_utf8<InputIterator, OutputIterator>(it, end, output);
     }
 
     return output;
 }
 
-bool is_lead_octet(unsigned char octet);
+/**
+ * Returns the length of the sequence started by a lead octet, 0 if the octet is not a lead octet.
+ */
+constexpr std::size_t get_lead_octet_sequence_length(unsigned char octet)
+{
+    return (utf8_octet_table::PROPERTIES[octet] & UTF8_OCTET_LEAD) ? (utf8_octet_table::PROPERTIES[octet] & UTF8_OCTET_LENGTH_MASK) + 1 : 0;
+}
+
+constexpr bool is_lead_octet(unsigned char octet)
+{
+    return (utf8_octet_table::PROPERTIES[octet] & UTF8_OCTET_LEAD) != 0;
+}
 
-std::size_t get_lead_octet_sequence_length(unsigned char octet);
+constexpr bool is_trail_octet(unsigned char octet)
+{
+    return (utf8_octet_table::PROPERTIES[octet] & UTF8_OCTET_TRAIL) != 0;
+}
 
-bool is_trail_octet(unsigned char octet);
+/**
+ * Result of the exception-free decoding functions.
+ */
+enum class utf8_status
+{
+    ok,
+    end_of_range, ///< Already at the end (or the beginning when iterating backward) of the range
+    invalid_octet, ///< Found an octet that can never appear in UTF-8
+    bad_lead_octet, ///< Found an octet that is not a lead octet where a sequence should start
+    truncated_sequence, ///< The sequence has less trail octets than announced by its lead octet
+    invalid_codepoint ///< The sequence is well-formed but encodes an invalid codepoint
+};
 
+struct utf8_decode_result
+{
+    utf8_status status;
+    char32_t codepoint; ///< Only meaningful for utf8_status::ok and utf8_status::invalid_codepoint
+    std::size_t length; ///< Number of octets of the sequence read before returning
+};
+
+/**
+ * Throws the exception corresponding to a failed decoding (result.status must not be utf8_status::ok).
+ * lead_octet is the first octet of the sequence (or the octet that was rejected).
+ */
+void throw_utf8_error(const utf8_decode_result& result, unsigned char lead_octet);
+
+/**
+ * Exception-free version of iterate_next_sequence: copies the next sequence in output
+ * (which must be able to hold 4 octets) without checking the codepoint it encodes.
+ *
+ * On error, it is left on the octet that made the decoding fail.
+ */
 template<typename InputIterator>
-int iterate_next_sequence(InputIterator & it, InputIterator end, unsigned char * output)
+utf8_decode_result decode_next_sequence(InputIterator & it, InputIterator end, unsigned char * output)
 {
     if(it == end)
-        throw bad_utf8_sequence_exception("Already at the end of the range!");
+        return utf8_decode_result{utf8_status::end_of_range, 0, 0};
 
     unsigned char first_codeunit = *it;
 
     if(!is_valid_utf8_octet(first_codeunit))
-        throw invalid_utf8_exception(std::to_string(first_codeunit) + " is not a valid UTF8 octet!");
+        return utf8_decode_result{utf8_status::invalid_octet, 0, 0};
 
     std::size_t sequence_length = get_lead_octet_sequence_length(first_codeunit);
     if(sequence_length == 0)
-        throw bad_utf8_sequence_exception("Bad head of sequence octet!");
+        return utf8_decode_result{utf8_status::bad_lead_octet, 0, 0};
 
     output[0] = first_codeunit;
     for(std::size_t i = 1; i < sequence_length; ++i)
     {
         ++it;
         if(it == end || !is_trail_octet(*it))
-            throw bad_utf8_sequence_exception("Not enough octets in a sequence: " + std::to_string(i) + " found but " + std::to_string(sequence_length) + " expected!");
-        else if(!is_valid_utf8_octet(*it))
-            throw invalid_utf8_exception(std::to_string(static_cast<unsigned char>(*it)) + " is not a valid UTF8 octet!");
+            return utf8_decode_result{utf8_status::truncated_sequence, 0, i};
 
         output[i] = *it;
     }
 
     ++it; // Last iteration to get past the last codeunit of the sequence
 
-    return sequence_length;
+    return utf8_decode_result{utf8_status::ok, 0, sequence_length};
 }
 
+const std::size_t UTF8_DFA_CLASSES_COUNT = 18;
+
+/**
+ * States: 0 accept, 1..3 one to three trail octets expected, 4 after ED (A0..BF encodes a surrogate),
+ * 5 after EF (BF may start U+FFFE or U+FFFF), 6 one trail expected (BE and BF encode U+FFFE and U+FFFF),
+ * 7 after F0, 8 after F0 8D (overlong surrogates), 9 after F0 8F, 10 after F4 (90..BF is too large),
+ * 11..13 one to three trail octets expected before an invalid codepoint. The others are final:
+ * 14 invalid codepoint, 15 truncated sequence, 16 invalid octet and 17 bad lead octet.
+ */
+const std::uint8_t UTF8_DFA_ACCEPT = 0;
+const std::uint8_t UTF8_DFA_INVALID_CODEPOINT = 14;
+const std::uint8_t UTF8_DFA_TRUNCATED_SEQUENCE = 15;
+const std::uint8_t UTF8_DFA_INVALID_OCTET = 16;
+const std::uint8_t UTF8_DFA_BAD_LEAD_OCTET = 17;
+
+/**
+ * Tables of the DFA used by decode_next, in the style of Bjoern Hoehrmann's decoder.
+ *
+ * Octets are first mapped to one of the 18 classes below, then the state is updated from
+ * the class of each octet of the sequence. The DFA accepts exactly what the previous
+ * sequence based decoder accepted: overlong 3 and 4 octets sequences are valid, the
+ * sequences encoding surrogates, U+FFFE, U+FFFF or codepoints above CODE_POINT_MAX are
+ * read entirely and reported as invalid codepoints.
+ *
+ * Classes: 0 ASCII, 1 trail 80..8C and 8E, 2 trail 8D, 3 trail 8F, 4 trail 90..9F,
+ * 5 trail A0..BD, 6 trail BE, 7 trail BF, 8 invalid octets (C0, C1, F5, FF), 9 C2..DF,
+ * 10 E0..EC and EE, 11 ED, 12 EF, 13 F0, 14 F1..F3, 15 F4, 16 F6 and F7, 17 F8..FE.
+ *
+ * The tables are static members (defined in Utf8Tools.cpp) so that decode_next, which
+ * indexes them at runtime, uses the same objects in every translation unit.
+ */
+struct utf8_dfa_table
+{
+    static constexpr std::uint8_t OCTET_CLASSES[256] = {
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  1,  3,
+         4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,
+         5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,
+         5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  6,  7,
+         8,  8,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+         9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,  9,
+        10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 11, 10, 12,
+        13, 14, 14, 14, 15,  8, 16, 16, 17, 17, 17, 17, 17, 17, 17,  8
+    };
+
+    /**
+     * Mask of the payload bits of the lead octets of each class.
+     */
+    static constexpr std::uint8_t LEAD_MASKS[UTF8_DFA_CLASSES_COUNT] = {
+        0x7F, 0, 0, 0, 0, 0, 0, 0, 0, 0x1F, 0x0F, 0x0F, 0x0F, 0x07, 0x07, 0x07, 0x07, 0
+    };
+
+    /**
+     * Next state, indexed by state * UTF8_DFA_CLASSES_COUNT + class (for the non-final states only).
+     */
+    static constexpr std::uint8_t TRANSITIONS[14 * UTF8_DFA_CLASSES_COUNT] = {
+         0, 17, 17, 17, 17, 17, 17, 17, 16,  1,  2,  4,  5,  7,  3, 10, 13, 17,
+        15,  0,  0,  0,  0,  0,  0,  0, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  1,  1,  1,  1,  1,  1,  1, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  2,  2,  2,  2,  2,  2, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  1,  1,  1,  1, 11, 11, 11, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  1,  1,  1,  1,  1,  1,  6, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  0,  0,  0,  0,  0, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  9,  2,  2,  2,  2, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  1,  1,  1,  1, 11, 11, 11, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  1,  1,  1,  1,  1,  1,  6, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  2,  2, 12, 12, 12, 12, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 14, 14, 14, 14, 14, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 11, 11, 11, 11, 11, 11, 11, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15, 12, 12, 12, 12, 12, 12, 12, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15
+    };
+};
+
+/**
+ * Exception-free version of iterate_next: decodes the next codepoint and moves it past its sequence.
+ * Validation and decoding are done in the same pass by a table-driven DFA.
+ *
+ * On error, it is left on the octet that made the decoding fail, except for
+ * utf8_status::invalid_codepoint where it is moved past the sequence.
+ */
 template<typename InputIterator>
-char32_t iterate_next(InputIterator & it, InputIterator end)
+utf8_decode_result decode_next(InputIterator & it, InputIterator end)
 {
-    unsigned char buffer[4];
-    std::size_t sequence_length = iterate_next_sequence(it, end, buffer);
+    if(it == end)
+        return utf8_decode_result{utf8_status::end_of_range, 0, 0};
+
+    unsigned char octet = *it;
+    if(octet < 0x80) // ASCII octets are always valid
+    {
+        ++it;
+        return utf8_decode_result{utf8_status::ok, octet, 1};
+    }
 
-    unsigned char first_codeunit_mask;
-    if(sequence_length == 1)
-        first_codeunit_mask = 0x7F;
-    else if(sequence_length == 2)
-        first_codeunit_mask = 0x1F;
-    else if(sequence_length == 3)
-        first_codeunit_mask = 0xF;
-    else if(sequence_length == 4)
-        first_codeunit_mask = 0x7;
+    std::uint8_t octet_class = utf8_dfa_table::OCTET_CLASSES[octet];
+    std::uint8_t state = utf8_dfa_table::TRANSITIONS[octet_class];
+    if(state >= UTF8_DFA_INVALID_OCTET)
+        return utf8_decode_result{(state == UTF8_DFA_INVALID_OCTET) ? utf8_status::invalid_octet : utf8_status::bad_lead_octet, 0, 0};
 
-    char32_t codepoint = (buffer[0] & first_codeunit_mask);
-    for(std::size_t i = 1; i < sequence_length; ++i)
+    char32_t codepoint = octet & utf8_dfa_table::LEAD_MASKS[octet_class];
+    std::size_t length = 1;
+    do
     {
-        codepoint = codepoint << 6;
-        codepoint |= buffer[i] & 0x3F;
+        ++it;
+        if(it == end)
+            return utf8_decode_result{utf8_status::truncated_sequence, 0, length};
+
+        octet = *it;
+        state = utf8_dfa_table::TRANSITIONS[state * UTF8_DFA_CLASSES_COUNT + utf8_dfa_table::OCTET_CLASSES[octet]];
+        if(state == UTF8_DFA_TRUNCATED_SEQUENCE)
+            return utf8_decode_result{utf8_status::truncated_sequence, 0, length};
+
+        codepoint = (codepoint << 6) | (octet & 0x3F);
+        ++length;
     }
+    while(state != UTF8_DFA_ACCEPT && state != UTF8_DFA_INVALID_CODEPOINT);
 
-    if(!is_valid_codepoint(codepoint))
-        throw invalid_codepoint_exception("This is an invalid codepoint: " + std::to_string(codepoint));
+    ++it; // Get past the last octet of the sequence
 
-    return codepoint;
+    return utf8_decode_result{(state == UTF8_DFA_ACCEPT) ? utf8_status::ok : utf8_status::invalid_codepoint, codepoint, length};
 }
 
+/**
+ * Result of complete_cut_sequence.
+ */
+struct utf8_cut_sequence_result
+{
+    utf8_decode_result decoded;
+    std::size_t chunk_octets; ///< Number of octets of the chunk read by the decoding
+    bool incomplete; ///< The chunk ended before the sequence, its octets were appended to the pending ones
+};
+
+/**
+ * Decodes a sequence cut by the end of the previous chunk of a stream, whose first
+ * pending_length octets (the valid start of a sequence) are in pending, with the first octets
+ * of the next chunk (which must not be empty). Used by the streaming decoders.
+ *
+ * pending (which must be able to hold 4 octets) and pending_length are only modified when the
+ * chunk is too short to end the sequence.
+ */
+inline utf8_cut_sequence_result complete_cut_sequence(unsigned char* pending, std::size_t& pending_length,
+                                                      const unsigned char* chunk, std::size_t length)
+{
+    unsigned char sequence[4];
+    std::size_t available = (length < sizeof(sequence) - pending_length) ? length : sizeof(sequence) - pending_length;
+    std::memcpy(sequence, pending, pending_length);
+    std::memcpy(sequence + pending_length, chunk, available);
+
+    const unsigned char* it = sequence;
+    const unsigned char* end = sequence + pending_length + available;
+    utf8_decode_result decoded = decode_next(it, end);
+    if(decoded.status == utf8_status::truncated_sequence && it == end)
+    {
+        std::memcpy(pending + pending_length, chunk, available);
+        pending_length += available;
+        return utf8_cut_sequence_result{decoded, available, true};
+    }
+
+    return utf8_cut_sequence_result{decoded, static_cast<std::size_t>(it - sequence) - pending_length, false};
+}
+
+/**
+ * Exception-free version of iterate_previous: moves it to the lead octet of the previous sequence.
+ * The sequence itself is not validated.
+ */
 template<typename InputIterator>
-void iterate_previous(InputIterator & it, InputIterator begin)
+utf8_status decode_previous(InputIterator & it, InputIterator begin)
 {
     if(it == begin)
-        throw bad_utf8_sequence_exception("Already at the beginning of the range!");
+        return utf8_status::end_of_range;
 
     --it;
-    std::size_t measured_sequence_length = 1;
     while(!is_lead_octet(*it) && it != begin)
     {
         if(!is_valid_utf8_octet(*it))
-            throw invalid_utf8_exception(std::to_string(static_cast<unsigned char>(*it)) + " is not a valid UTF8 octet!");
+            return utf8_status::invalid_octet;
         else if(!is_trail_octet(*it))
-            throw bad_utf8_sequence_exception("Found an octet that is not a lead or a trail octet!");
+            return utf8_status::bad_lead_octet;
 
-        ++measured_sequence_length;
         --it;
     }
 
     if(!is_lead_octet(*it)) // It means we stopped because we reached the beginning without finding a lead octet
-        throw bad_utf8_sequence_exception("Can't find a lead octet until the beginning of the range!");
+        return utf8_status::bad_lead_octet;
+
+    return utf8_status::ok;
 }
 
-template<typename InputIterator, typename OutputIterator>
-OutputIterator utf8_to_utf32(InputIterator begin, InputIterator end, OutputIterator output)
+template<typename InputIterator>
+int iterate_next_sequence(InputIterator & it, InputIterator end, unsigned char * output)
+{
+    unsigned char first_codeunit = (it != end) ? *it : 0;
+    utf8_decode_result result = decode_next_sequence(it, end, output);
+    if(result.status != utf8_status::ok)
+        throw_utf8_error(result, first_codeunit);
+
+    return result.length;
+}
+
+template<typename InputIterator>
+char32_t iterate_next(InputIterator & it, InputIterator end)
+{
+    unsigned char first_codeunit = (it != end) ? *it : 0;
+    utf8_decode_result result = decode_next(it, end);
+    if(result.status != utf8_status::ok)
+        throw_utf8_error(result, first_codeunit);
+
+    return result.codepoint;
+}
+
+template<typename InputIterator>
+void iterate_previous(InputIterator & it, InputIterator begin)
+{
+    utf8_status status = decode_previous(it, begin);
+    if(status != utf8_status::ok)
+        throw_utf8_error(utf8_decode_result{status, 0, 0}, (status == utf8_status::end_of_range) ? 0 : *it);
+}
+
+/**
+ * Decodes the next codepoint, replacing malformed sequences by REPLACEMENT_CHARACTER
+ * instead of throwing.
+ *
+ * Each maximal subpart of an invalid sequence (the longest prefix of a valid sequence,
+ * or a single octet if there is none) is replaced by exactly one REPLACEMENT_CHARACTER,
+ * like the WHATWG Encoding Standard does. A sequence is valid if iterate_next accepts it.
+ */
+template<typename InputIterator>
+char32_t decode_next_lossy(InputIterator & it, InputIterator end)
+{
+    if(it == end)
+        return REPLACEMENT_CHARACTER;
+
+    unsigned char lead = *it;
+    ++it;
+    if(lead < 0x80)
+        return lead;
+
+    // Sequence length, first codeunit mask and range of the second octet
+    std::size_t sequence_length;
+    char32_t codepoint;
+    unsigned char lower = 0x80;
+    unsigned char upper = 0xBF;
+    if(lead >= 0xC2 && lead <= 0xDF)
+    {
+        sequence_length = 2;
+        codepoint = lead & 0x1F;
+    }
+    else if(lead >= 0xE0 && lead <= 0xEF)
+    {
+        sequence_length = 3;
+        codepoint = lead & 0xF;
+        if(lead == 0xED) // Excludes surrogates
+            upper = 0x9F;
+    }
+    else if(lead >= 0xF0 && lead <= 0xF4)
+    {
+        sequence_length = 4;
+        codepoint = lead & 0x7;
+        if(lead == 0xF4) // Excludes codepoints above CODE_POINT_MAX
+            upper = 0x8F;
+    }
+    else
+    {
+        return REPLACEMENT_CHARACTER;
+    }
+
+    for(std::size_t i = 1; i < sequence_length; ++i)
+    {
+        if(it == end)
+            return REPLACEMENT_CHARACTER;
+
+        unsigned char octet = *it;
+        if(octet < lower || octet > upper)
+            return REPLACEMENT_CHARACTER;
+
+        codepoint = (codepoint << 6) | (octet & 0x3F);
+        ++it;
+
+        // Range of the next octet: only the noncharacters U+FFFE and U+FFFF and the
+        // (overlong) 4 octets encodings of surrogates need a narrower range
+        lower = 0x80;
+        upper = 0xBF;
+        if(codepoint == 0x3FF) // EF BF or F0 8F BF
+            upper = 0xBD;
+        else if(sequence_length == 4 && i == 1 && codepoint == 0xD) // F0 8D
+            upper = 0x9F;
+    }
+
+    return codepoint;
+}
+
+/**
+ * Moves it to the beginning of the previous codepoint (or previous replaced subpart),
+ * consistently with decode_next_lossy. Does nothing if it is already at begin.
+ */
+template<typename InputIterator>
+void decode_previous_lossy(InputIterator & it, InputIterator begin)
+{
+    if(it == begin)
+        return;
+
+    // Only a lead octet at most 4 octets before can start a sequence ending here
+    InputIterator lead = it;
+    std::size_t distance = 0;
+    do
+    {
+        --lead;
+        ++distance;
+    }
+    while(lead != begin && distance < 4 && is_trail_octet(*lead));
+
+    if(distance > 1 && !is_trail_octet(*lead))
+    {
+        InputIterator sequence_end = lead;
+        decode_next_lossy(sequence_end, it);
+        if(sequence_end == it)
+        {
+            it = lead;
+            return;
+        }
+    }
+
+    --it; // Single invalid octet (or ASCII)
+}
+
+/**
+ * Decodes the next codepoint of a range known to be valid UTF-8, without any check.
+ * Malformed input gives meaningless codepoints (but never reads past end).
+ */
+template<typename InputIterator>
+char32_t decode_next_trusted(InputIterator & it, InputIterator end)
+{
+    unsigned char lead = *it;
+    ++it;
+    if(lead < 0x80)
+        return lead;
+
+    std::size_t sequence_length = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : 2;
+    char32_t codepoint = lead & (0x7F >> sequence_length);
+    for(std::size_t i = 1; i < sequence_length && it != end; ++i, ++it)
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(*it) & 0x3F);
+
+    return codepoint;
+}
+
+/**
+ * Moves it to the lead octet of the previous sequence of a range known to be valid UTF-8.
+ */
+template<typename InputIterator>
+void decode_previous_trusted(InputIterator & it, InputIterator begin)
+{
+    do
+    {
+        --it;
+    }
+    while(it != begin && (static_cast<unsigned char>(*it) & 0xC0) == 0x80);
+}
+
+/*
+ * Decoding policies tell the iterators and converters how to handle malformed UTF-8.
+ * - next(it, end) decodes the next codepoint and moves it past its sequence,
+ * - previous(it, begin) moves it to the beginning of the previous codepoint,
+ * - try_next(it, end) is the exception-free version of next: errors are reported
+ *   in the returned status (it is only meaningful if the status is utf8_status::ok).
+ */
+
+/**
+ * Decoding policy throwing an exception when malformed UTF-8 is encountered.
+ */
+class strict_decoding
+{
+public:
+    template<typename InputIterator>
+    static char32_t next(InputIterator & it, InputIterator end)
+    {
+        return iterate_next(it, end);
+    }
+
+    template<typename InputIterator>
+    static void previous(InputIterator & it, InputIterator begin)
+    {
+        iterate_previous(it, begin);
+    }
+
+    template<typename InputIterator>
+    static utf8_decode_result try_next(InputIterator & it, InputIterator end)
+    {
+        return decode_next(it, end);
+    }
+};
+
+/**
+ * Decoding policy replacing malformed UTF-8 by REPLACEMENT_CHARACTER (see decode_next_lossy).
+ */
+class lossy_decoding
+{
+public:
+    template<typename InputIterator>
+    static char32_t next(InputIterator & it, InputIterator end)
+    {
+        return decode_next_lossy(it, end);
+    }
+
+    template<typename InputIterator>
+    static void previous(InputIterator & it, InputIterator begin)
+    {
+        decode_previous_lossy(it, begin);
+    }
+
+    template<typename InputIterator>
+    static utf8_decode_result try_next(InputIterator & it, InputIterator end)
+    {
+        if(it == end)
+            return utf8_decode_result{utf8_status::end_of_range, 0, 0};
+
+        InputIterator begin = it;
+        char32_t codepoint = decode_next_lossy(it, end);
+        return utf8_decode_result{utf8_status::ok, codepoint, static_cast<std::size_t>(std::distance(begin, it))};
+    }
+};
+
+/**
+ * Decoding policy for strings already known to be valid (e.g. checked with string::is_valid()):
+ * no check at all is done (see decode_next_trusted).
+ */
+class trusted_decoding
+{
+public:
+    template<typename InputIterator>
+    static char32_t next(InputIterator & it, InputIterator end)
+    {
+        return decode_next_trusted(it, end);
+    }
+
+    template<typename InputIterator>
+    static void previous(InputIterator & it, InputIterator begin)
+    {
+        decode_previous_trusted(it, begin);
+    }
+
+    template<typename InputIterator>
+    static utf8_decode_result try_next(InputIterator & it, InputIterator end)
+    {
+        if(it == end)
+            return utf8_decode_result{utf8_status::end_of_range, 0, 0};
+
+        InputIterator begin = it;
+        char32_t codepoint = decode_next_trusted(it, end);
+        return utf8_decode_result{utf8_status::ok, codepoint, static_cast<std::size_t>(std::distance(begin, it))};
+    }
+};
+
+template<typename InputIterator, typename OutputIterator, typename DecodingPolicy>
+OutputIterator utf8_to_utf32(InputIterator begin, InputIterator end, OutputIterator output, DecodingPolicy)
 {
     for(auto it = begin; it != end; )
     {
-        *(output++) = iterate_next(it, end);
+        // ASCII runs are widened without being decoded
+        output = copy_ascii_run<unsigned char>(it, end, output);
+
+        if(it == end)
+            break;
+
+        *(output++) = DecodingPolicy::next(it, end);
     }
 
     return output;
 }
 
+template<typename InputIterator, typename OutputIterator>
+OutputIterator utf8_to_utf32(InputIterator begin, InputIterator end, OutputIterator output)
+{
+    return utf8_to_utf32(begin, end, output, strict_decoding());
+}
+
 template<typename OutputIterator>
 OutputIterator codepoint_to_utf16(char32_t codepoint, OutputIterator output)
 {
@@ -263,32 +991,36 @@ OutputIterator codepoint_to_utf16(char32_t codepoint, OutputIterator output)
     return output;
 }
 
-template<typename InputIterator, typename OutputIterator>
-OutputIterator utf8_to_utf16(InputIterator begin, InputIterator end, OutputIterator output)
+template<typename InputIterator, typename OutputIterator, typename DecodingPolicy>
+OutputIterator utf8_to_utf16(InputIterator begin, InputIterator end, OutputIterator output, DecodingPolicy)
 {
     for(auto it = begin; it != end; )
     {
-        char32_t codepoint = iterate_next(it, end);
+        output = copy_ascii_run<unsigned char>(it, end, output);
+
+        if(it == end)
+            break;
+
+        char32_t codepoint = DecodingPolicy::next(it, end);
         output = codepoint_to_utf16(codepoint, output);
     }
 
     return output;
 }
 
+template<typename InputIterator, typename OutputIterator>
+OutputIterator utf8_to_utf16(InputIterator begin, InputIterator end, OutputIterator output)
+{
+    return utf8_to_utf16(begin, end, output, strict_decoding());
+}
+
 template<typename InputIterator>
 bool is_valid_utf8(InputIterator begin, InputIterator end)
 {
-    unsigned char buffer[4];
     for(auto it = begin; it != end; )
     {
-        try
-        {
-            iterate_next(it, end);
-        }
-        catch(...) // Some kind of exception was thrown when interpreting the UTF-8, so it's invalid
-        {
+        if(decode_next(it, end).status != utf8_status::ok)
             return false;
-        }
     }
 
     return true;
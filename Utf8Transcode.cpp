@@ -0,0 +1,822 @@
+#include "Utf8Transcode.hpp"
+
+#include "Utf8Tools.hpp"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define UNICPP_SIMD_X86
+#include <immintrin.h>
+#define UNICPP_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define UNICPP_TARGET_AVX2 __attribute__((target("avx2")))
+// The SSE4.2 steps are shared by the AVX2 kernels, which GCC does not inline them into by itself
+#define UNICPP_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace unicpp
+{
+
+namespace
+{
+
+#ifdef UNICPP_SIMD_X86
+
+/*
+ * UTF-8 decoding
+ *
+ * The kernels work on chunks of 64 octets of valid UTF-8 starting on a lead octet. The masks of
+ * the non-trail and non-ASCII octets of a chunk are computed once, then the chunk is decoded in steps:
+ * - 16 ASCII octets are widened,
+ * - otherwise the ends of the sequences in the next 12 octets (the octets followed by a non-trail
+ *   octet) select a shuffle gathering the octets in lanes where a few shifts and masks decode them:
+ *   six sequences of 1 or 2 octets in 16 bits lanes [last octet, lead octet or 0], or four
+ *   sequences of 1 to 3 octets in 32 bits lanes [last octet, middle octet, lead octet, 0],
+ * - the steps starting with a 4 octets sequence (or with 3 octets sequences only) decode one codepoint.
+ * Only the position in the chunk is carried from a step to the next one, so that they overlap.
+ */
+
+const std::size_t UTF8_CHUNK_SIZE = 64;
+const std::size_t UTF8_END_MASKS = 1 << 12;
+
+struct utf8_block_entry
+{
+    std::uint8_t consumed; // Octets of the decoded sequences, 0 if the step decodes one codepoint
+    std::uint8_t units; // 6 (16 bits lanes) or 4 (32 bits lanes)
+    std::uint16_t shuffle; // Index in utf8_block_tables::shuffles
+};
+
+struct utf8_block_tables
+{
+    utf8_block_entry entries[UTF8_END_MASKS];
+    std::vector<std::array<std::uint8_t, 16>> shuffles;
+};
+
+const utf8_block_tables& get_utf8_block_tables()
+{
+    static const utf8_block_tables tables = []()
+    {
+        utf8_block_tables result;
+        std::map<std::array<std::uint8_t, 16>, std::uint16_t> known;
+
+        for(std::size_t mask = 0; mask < UTF8_END_MASKS; ++mask)
+        {
+            std::vector<std::size_t> lengths;
+            std::size_t start = 0;
+            for(std::size_t i = 0; i < 12; ++i)
+            {
+                if(mask & (std::size_t(1) << i))
+                {
+                    lengths.push_back(i + 1 - start);
+                    start = i + 1;
+                }
+            }
+
+            auto all_at_most = [&lengths](std::size_t count, std::size_t length)
+            {
+                if(lengths.size() < count)
+                    return false;
+                for(std::size_t k = 0; k < count; ++k)
+                    if(lengths[k] > length)
+                        return false;
+                return true;
+            };
+
+            std::array<std::uint8_t, 16> shuffle;
+            shuffle.fill(0x80);
+            std::size_t units = 0;
+            start = 0;
+            if(all_at_most(6, 2))
+            {
+                units = 6;
+                for(std::size_t k = 0; k < units; start += lengths[k], ++k)
+                {
+                    shuffle[2 * k] = start + lengths[k] - 1;
+                    if(lengths[k] == 2)
+                        shuffle[2 * k + 1] = start;
+                }
+            }
+            else if(all_at_most(4, 3))
+            {
+                units = 4;
+                for(std::size_t k = 0; k < units; start += lengths[k], ++k)
+                {
+                    for(std::size_t i = 0; i < lengths[k]; ++i)
+                        shuffle[4 * k + i] = start + lengths[k] - 1 - i;
+                }
+            }
+
+            utf8_block_entry& entry = result.entries[mask];
+            entry.consumed = start;
+            entry.units = units;
+
+            auto found = known.find(shuffle);
+            if(found == known.end())
+            {
+                found = known.insert(std::make_pair(shuffle, result.shuffles.size())).first;
+                result.shuffles.push_back(shuffle);
+            }
+            entry.shuffle = found->second;
+        }
+
+        return result;
+    }();
+
+    return tables;
+}
+
+struct utf8_chunk_masks
+{
+    std::uint64_t non_trails;
+    std::uint64_t non_ascii;
+};
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE utf8_chunk_masks sse42_chunk_masks(const unsigned char* chunk)
+{
+    utf8_chunk_masks masks{0, 0};
+    for(std::size_t i = 0; i < UTF8_CHUNK_SIZE; i += 16)
+    {
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + i));
+
+        // Signed comparison: the trail octets are the only ones below 0xC0 as signed values
+        const std::uint32_t non_trails = _mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8(static_cast<char>(0xBF))));
+        const std::uint32_t non_ascii = _mm_movemask_epi8(input);
+        masks.non_trails |= static_cast<std::uint64_t>(non_trails) << i;
+        masks.non_ascii |= static_cast<std::uint64_t>(non_ascii) << i;
+    }
+
+    return masks;
+}
+
+UNICPP_TARGET_AVX2 UNICPP_ALWAYS_INLINE utf8_chunk_masks avx2_chunk_masks(const unsigned char* chunk)
+{
+    utf8_chunk_masks masks{0, 0};
+    for(std::size_t i = 0; i < UTF8_CHUNK_SIZE; i += 32)
+    {
+        const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chunk + i));
+
+        const std::uint32_t non_trails = _mm256_movemask_epi8(_mm256_cmpgt_epi8(input, _mm256_set1_epi8(static_cast<char>(0xBF))));
+        const std::uint32_t non_ascii = _mm256_movemask_epi8(input);
+        masks.non_trails |= static_cast<std::uint64_t>(non_trails) << i;
+        masks.non_ascii |= static_cast<std::uint64_t>(non_ascii) << i;
+    }
+
+    return masks;
+}
+
+/*
+ * Stores of the decoded code units, to UTF-16 or UTF-32.
+ */
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_ascii(__m128i octets, char16_t* output)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_cvtepu8_epi16(octets));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 8), _mm_unpackhi_epi8(octets, _mm_setzero_si128()));
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_ascii(__m128i octets, char32_t* output)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_cvtepu8_epi32(octets));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4), _mm_cvtepu8_epi32(_mm_srli_si128(octets, 4)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 8), _mm_cvtepu8_epi32(_mm_srli_si128(octets, 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 12), _mm_cvtepu8_epi32(_mm_srli_si128(octets, 12)));
+}
+
+UNICPP_TARGET_AVX2 UNICPP_ALWAYS_INLINE void avx2_store_ascii(__m256i octets, char16_t* output)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(octets)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(octets, 1)));
+}
+
+UNICPP_TARGET_AVX2 UNICPP_ALWAYS_INLINE void avx2_store_ascii(__m256i octets, char32_t* output)
+{
+    const __m128i low = _mm256_castsi256_si128(octets);
+    const __m128i high = _mm256_extracti128_si256(octets, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_cvtepu8_epi32(low));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 16), _mm256_cvtepu8_epi32(high));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+}
+
+/**
+ * Stores 8 code units below U+10000, given in 16 bits lanes.
+ */
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_units(__m128i units, char16_t* output)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), units);
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_units(__m128i units, char32_t* output)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_cvtepu16_epi32(units));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4), _mm_unpackhi_epi16(units, _mm_setzero_si128()));
+}
+
+/**
+ * Stores 4 code units below U+10000, given in 32 bits lanes.
+ */
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_wide_units(__m128i units, char16_t* output)
+{
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output), _mm_packus_epi32(units, units));
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_wide_units(__m128i units, char32_t* output)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), units);
+}
+
+inline char16_t* store_codepoint(char32_t codepoint, char16_t* output)
+{
+    return codepoint_to_utf16(codepoint, output);
+}
+
+inline char32_t* store_codepoint(char32_t codepoint, char32_t* output)
+{
+    *output = codepoint;
+    return output + 1;
+}
+
+/*
+ * The wide strings are stored by the intrinsics (which may alias any type) as the code units
+ * of the same width, and by the scalar code as wchar_t.
+ */
+using wide_simd_unit = std::conditional<sizeof(wchar_t) == 4, char32_t, char16_t>::type;
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_ascii(__m128i octets, wchar_t* output)
+{
+    sse42_store_ascii(octets, reinterpret_cast<wide_simd_unit*>(output));
+}
+
+UNICPP_TARGET_AVX2 UNICPP_ALWAYS_INLINE void avx2_store_ascii(__m256i octets, wchar_t* output)
+{
+    avx2_store_ascii(octets, reinterpret_cast<wide_simd_unit*>(output));
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_units(__m128i units, wchar_t* output)
+{
+    sse42_store_units(units, reinterpret_cast<wide_simd_unit*>(output));
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_store_wide_units(__m128i units, wchar_t* output)
+{
+    sse42_store_wide_units(units, reinterpret_cast<wide_simd_unit*>(output));
+}
+
+inline wchar_t* store_codepoint(char32_t codepoint, wchar_t* output)
+{
+    if(sizeof(wchar_t) == 2)
+        return codepoint_to_utf16(codepoint, output);
+
+    *output = static_cast<wchar_t>(codepoint);
+    return output + 1;
+}
+
+/**
+ * Decodes the beginning of a chunk and returns the number of octets decoded (more than 48).
+ * The output must have room for 2 more code units than the decoded sequences give.
+ */
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE std::size_t sse42_decode_utf8_chunk(const utf8_block_tables& tables, const unsigned char* chunk,
+                                                                utf8_chunk_masks masks, CodeUnit*& output)
+{
+    std::size_t position = 0;
+    while(position <= UTF8_CHUNK_SIZE - 16)
+    {
+        if(((masks.non_ascii >> position) & 0xFFFF) == 0)
+        {
+            sse42_store_ascii(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + position)), output);
+            position += 16;
+            output += 16;
+            continue;
+        }
+
+        const utf8_block_entry& entry = tables.entries[(masks.non_trails >> (position + 1)) & (UTF8_END_MASKS - 1)];
+        if(entry.consumed == 0)
+        {
+            const unsigned char* it = chunk + position;
+            output = store_codepoint(decode_next_trusted(it, it + 4), output);
+            position = it - chunk;
+            continue;
+        }
+
+        const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chunk + position));
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffles[entry.shuffle].data()));
+        const __m128i lanes = _mm_shuffle_epi8(input, shuffle);
+        if(entry.units == 6)
+        {
+            const __m128i low = _mm_and_si128(lanes, _mm_set1_epi16(0x7F));
+            const __m128i high = _mm_and_si128(_mm_srli_epi16(lanes, 2), _mm_set1_epi16(0x7C0));
+            sse42_store_units(_mm_or_si128(low, high), output);
+        }
+        else
+        {
+            const __m128i low = _mm_and_si128(lanes, _mm_set1_epi32(0x7F));
+            const __m128i middle = _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0xFC0));
+            const __m128i high = _mm_and_si128(_mm_srli_epi32(lanes, 4), _mm_set1_epi32(0xF000));
+            sse42_store_wide_units(_mm_or_si128(_mm_or_si128(low, middle), high), output);
+        }
+
+        position += entry.consumed;
+        output += entry.units;
+    }
+
+    return position;
+}
+
+/**
+ * Decodes the valid UTF-8 starting at it until less than a chunk (and some margin for the
+ * output) remains before valid_end, returns the end of the decoded input.
+ */
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 const unsigned char* decode_utf8_sse42(const unsigned char* it, const unsigned char* valid_end, CodeUnit*& output_end)
+{
+    const utf8_block_tables& tables = get_utf8_block_tables();
+    CodeUnit* output = output_end;
+
+    while(static_cast<std::size_t>(valid_end - it) >= UTF8_CHUNK_SIZE + 16)
+    {
+        const utf8_chunk_masks masks = sse42_chunk_masks(it);
+        if(masks.non_ascii == 0)
+        {
+            for(std::size_t i = 0; i < UTF8_CHUNK_SIZE; i += 16)
+                sse42_store_ascii(_mm_loadu_si128(reinterpret_cast<const __m128i*>(it + i)), output + i);
+            it += UTF8_CHUNK_SIZE;
+            output += UTF8_CHUNK_SIZE;
+            continue;
+        }
+
+        it += sse42_decode_utf8_chunk(tables, it, masks, output);
+    }
+
+    output_end = output;
+    return it;
+}
+
+template<typename CodeUnit>
+UNICPP_TARGET_AVX2 const unsigned char* decode_utf8_avx2(const unsigned char* it, const unsigned char* valid_end, CodeUnit*& output_end)
+{
+    const utf8_block_tables& tables = get_utf8_block_tables();
+    CodeUnit* output = output_end;
+
+    while(static_cast<std::size_t>(valid_end - it) >= UTF8_CHUNK_SIZE + 16)
+    {
+        const utf8_chunk_masks masks = avx2_chunk_masks(it);
+        if(masks.non_ascii == 0)
+        {
+            for(std::size_t i = 0; i < UTF8_CHUNK_SIZE; i += 32)
+                avx2_store_ascii(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(it + i)), output + i);
+            it += UTF8_CHUNK_SIZE;
+            output += UTF8_CHUNK_SIZE;
+            continue;
+        }
+
+        it += sse42_decode_utf8_chunk(tables, it, masks, output);
+    }
+
+    output_end = output;
+    return it;
+}
+
+/*
+ * UTF-8 encoding
+ *
+ * Blocks of 8 codepoints below U+0800 (Latin, Greek, Cyrillic...) are encoded in 16 bits lanes
+ * holding the ASCII octet or the 2 octets sequence, and a shuffle selected by the lanes holding
+ * 2 octets packs them. Other codepoints are widened to 32 bits lanes holding their whole UTF-8
+ * sequence, first octet in the lowest byte, and a shuffle selected by the lengths (2 bits per
+ * lane, length - 1) packs 4 lanes. The blocks with surrogates, U+FFFE, U+FFFF or values above
+ * U+10FFFF go through the scalar functions, which throw as usual.
+ */
+
+const std::size_t UTF8_PACK_MASKS = 1 << 8;
+
+struct utf8_pack_entry
+{
+    std::array<std::uint8_t, 16> shuffle;
+    std::uint8_t length;
+};
+
+struct utf8_pack_tables
+{
+    utf8_pack_entry two_octets[UTF8_PACK_MASKS]; // By mask of the 16 bits lanes holding 2 octets
+    utf8_pack_entry lengths[UTF8_PACK_MASKS]; // By lengths of the 32 bits lanes
+};
+
+const utf8_pack_tables& get_utf8_pack_tables()
+{
+    static const utf8_pack_tables tables = []()
+    {
+        utf8_pack_tables result;
+        for(std::size_t code = 0; code < UTF8_PACK_MASKS; ++code)
+        {
+            utf8_pack_entry& two_octets = result.two_octets[code];
+            two_octets.shuffle.fill(0x80);
+            two_octets.length = 0;
+            for(std::size_t lane = 0; lane < 8; ++lane)
+            {
+                two_octets.shuffle[two_octets.length++] = 2 * lane;
+                if(code & (std::size_t(1) << lane))
+                    two_octets.shuffle[two_octets.length++] = 2 * lane + 1;
+            }
+
+            utf8_pack_entry& lengths = result.lengths[code];
+            lengths.shuffle.fill(0x80);
+            lengths.length = 0;
+            for(std::size_t lane = 0; lane < 4; ++lane)
+            {
+                std::size_t length = ((code >> (2 * lane)) & 0x03) + 1;
+                for(std::size_t i = 0; i < length; ++i)
+                    lengths.shuffle[lengths.length++] = 4 * lane + i;
+            }
+        }
+
+        return result;
+    }();
+
+    return tables;
+}
+
+/**
+ * Spreads the 4 bits of a movemask to the low bit of 4 two bits fields.
+ */
+inline unsigned spread_lanes(unsigned mask)
+{
+    return (mask & 0x01) | ((mask & 0x02) << 1) | ((mask & 0x04) << 2) | ((mask & 0x08) << 3);
+}
+
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE unsigned lanes_mask(__m128i mask)
+{
+    return spread_lanes(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+}
+
+/**
+ * Writes the UTF-8 sequences of 4 valid codepoints (in 32 bits lanes), which are all below
+ * U+10000 unless Supplementary is true. The output must have room for 16 octets.
+ */
+template<bool Supplementary>
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_pack_utf8(const utf8_pack_tables& tables, __m128i codepoints, char*& output)
+{
+    const __m128i trail_0 = _mm_or_si128(_mm_and_si128(codepoints, _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+    const __m128i trail_1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(codepoints, 6), _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+
+    const __m128i two = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(codepoints, 6), _mm_set1_epi32(0xC0)), _mm_slli_epi32(trail_0, 8));
+    const __m128i three = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(codepoints, 12), _mm_set1_epi32(0xE0)),
+                                       _mm_or_si128(_mm_slli_epi32(trail_1, 8), _mm_slli_epi32(trail_0, 16)));
+
+    const __m128i at_least_two = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0x7F));
+    const __m128i at_least_three = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0x7FF));
+    __m128i sequences = _mm_blendv_epi8(_mm_blendv_epi8(codepoints, two, at_least_two), three, at_least_three);
+    unsigned code = lanes_mask(at_least_two) + lanes_mask(at_least_three);
+
+    if(Supplementary)
+    {
+        const __m128i trail_2 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(codepoints, 12), _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+        const __m128i four = _mm_or_si128(_mm_or_si128(_mm_srli_epi32(codepoints, 18), _mm_set1_epi32(0xF0)),
+                                          _mm_or_si128(_mm_slli_epi32(trail_2, 8),
+                                                       _mm_or_si128(_mm_slli_epi32(trail_1, 16), _mm_slli_epi32(trail_0, 24))));
+
+        const __m128i four_octets = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0xFFFF));
+        sequences = _mm_blendv_epi8(sequences, four, four_octets);
+        code += lanes_mask(four_octets);
+    }
+
+    const utf8_pack_entry& entry = tables.lengths[code];
+    const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entry.shuffle.data()));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(sequences, shuffle));
+    output += entry.length;
+}
+
+/**
+ * Writes the UTF-8 sequences of 8 codepoints below U+10000 (in 16 bits lanes) which are not
+ * surrogates, U+FFFE or U+FFFF. The output must have room for the sequences plus 12 octets.
+ */
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_encode_bmp(const utf8_pack_tables& tables, __m128i units, char*& output)
+{
+    if(_mm_testz_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))))
+    {
+        const __m128i trail = _mm_or_si128(_mm_and_si128(units, _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80));
+        const __m128i two = _mm_or_si128(_mm_or_si128(_mm_srli_epi16(units, 6), _mm_set1_epi16(0xC0)), _mm_slli_epi16(trail, 8));
+        const __m128i two_octets = _mm_cmpgt_epi16(units, _mm_set1_epi16(0x7F));
+        const __m128i sequences = _mm_blendv_epi8(units, two, two_octets);
+
+        const utf8_pack_entry& entry = tables.two_octets[_mm_movemask_epi8(_mm_packs_epi16(two_octets, two_octets)) & 0xFF];
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entry.shuffle.data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(sequences, shuffle));
+        output += entry.length;
+        return;
+    }
+
+    sse42_pack_utf8<false>(tables, _mm_cvtepu16_epi32(units), output);
+    sse42_pack_utf8<false>(tables, _mm_unpackhi_epi16(units, _mm_setzero_si128()), output);
+}
+
+/**
+ * Returns true if one of the 8 code units is a surrogate, U+FFFE or U+FFFF.
+ */
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE bool sse42_has_special_units(__m128i units)
+{
+    const __m128i surrogates = _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))),
+                                               _mm_set1_epi16(static_cast<short>(0xD800)));
+    const __m128i non_characters = _mm_cmpeq_epi16(_mm_or_si128(units, _mm_set1_epi16(1)), _mm_set1_epi16(-1));
+    return !_mm_testz_si128(_mm_or_si128(surrogates, non_characters), _mm_set1_epi16(-1));
+}
+
+/**
+ * Returns true if one of the 4 codepoints is not valid (see is_valid_codepoint).
+ */
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE bool sse42_has_invalid_codepoints(__m128i codepoints)
+{
+    const __m128i valid_range = _mm_cmpeq_epi32(_mm_min_epu32(codepoints, _mm_set1_epi32(CODE_POINT_MAX)), codepoints);
+    const __m128i surrogates = _mm_cmpeq_epi32(_mm_and_si128(codepoints, _mm_set1_epi32(0xFFFFF800)), _mm_set1_epi32(0xD800));
+    const __m128i non_characters = _mm_cmpeq_epi32(_mm_or_si128(codepoints, _mm_set1_epi32(1)), _mm_set1_epi32(0xFFFF));
+    return _mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(surrogates, non_characters), valid_range)) != 0xFFFF;
+}
+
+/**
+ * Converts 8 code units. There must be at least 20 code units after it, so that the output
+ * has room for the 16 octets stores.
+ */
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_utf16_block_to_utf8(const utf8_pack_tables& tables, const CodeUnit*& it, const CodeUnit* end, char*& output)
+{
+    const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    if(_mm_testz_si128(units, _mm_set1_epi16(static_cast<short>(0xFF80))))
+    {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(output), _mm_packus_epi16(units, units));
+        it += 8;
+        output += 8;
+        return;
+    }
+
+    if(sse42_has_special_units(units))
+    {
+        const CodeUnit* block_end = it + 8;
+        while(it < block_end)
+            output = utf16_character_to_utf8(it, end, output);
+        return;
+    }
+
+    sse42_encode_bmp(tables, units, output);
+    it += 8;
+}
+
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 const CodeUnit* utf16_to_utf8_sse42(const CodeUnit* it, const CodeUnit* end, char*& output_end)
+{
+    const utf8_pack_tables& tables = get_utf8_pack_tables();
+    char* output = output_end;
+
+    while(end - it >= 20)
+        sse42_utf16_block_to_utf8(tables, it, end, output);
+
+    output_end = output;
+    return it;
+}
+
+/**
+ * Converts 8 codepoints. There must be at least 20 codepoints after it, so that the output
+ * has room for the 16 octets stores.
+ */
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 UNICPP_ALWAYS_INLINE void sse42_utf32_block_to_utf8(const utf8_pack_tables& tables, const CodeUnit*& it, char*& output)
+{
+    const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it));
+    const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(it + 4));
+    const __m128i all = _mm_or_si128(first, second);
+
+    if(_mm_testz_si128(all, _mm_set1_epi32(~0x7F)))
+    {
+        const __m128i units = _mm_packus_epi32(first, second);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(output), _mm_packus_epi16(units, units));
+        it += 8;
+        output += 8;
+        return;
+    }
+
+    if(_mm_testz_si128(all, _mm_set1_epi32(0xFFFF0000)))
+    {
+        const __m128i units = _mm_packus_epi32(first, second);
+        if(!sse42_has_special_units(units))
+        {
+            sse42_encode_bmp(tables, units, output);
+            it += 8;
+            return;
+        }
+    }
+    else if(!sse42_has_invalid_codepoints(first) && !sse42_has_invalid_codepoints(second))
+    {
+        sse42_pack_utf8<true>(tables, first, output);
+        sse42_pack_utf8<true>(tables, second, output);
+        it += 8;
+        return;
+    }
+
+    for(const CodeUnit* block_end = it + 8; it != block_end; ++it)
+        output = codepoint_to_utf8(*it, output);
+}
+
+template<typename CodeUnit>
+UNICPP_TARGET_SSE42 const CodeUnit* utf32_to_utf8_sse42(const CodeUnit* it, const CodeUnit* end, char*& output_end)
+{
+    const utf8_pack_tables& tables = get_utf8_pack_tables();
+    char* output = output_end;
+
+    while(end - it >= 20)
+        sse42_utf32_block_to_utf8(tables, it, output);
+
+    output_end = output;
+    return it;
+}
+
+#endif
+
+/*
+ * The transcoders are written once for char16_t, char32_t and wchar_t, which goes through
+ * the functions of the encoding with the same width.
+ */
+template<typename CodeUnit, std::size_t Size = sizeof(CodeUnit)>
+struct unit_encoding;
+
+template<typename CodeUnit>
+struct unit_encoding<CodeUnit, 2>
+{
+    template<typename DecodingPolicy>
+    static CodeUnit* from_utf8(const char* begin, const char* end, CodeUnit* output, DecodingPolicy policy)
+    {
+        return utf8_to_utf16(begin, end, output, policy);
+    }
+
+    static char* to_utf8(const CodeUnit* begin, const CodeUnit* end, char* output)
+    {
+        return utf16_to_utf8(begin, end, output);
+    }
+
+#ifdef UNICPP_SIMD_X86
+    static const CodeUnit* to_utf8_sse42(const CodeUnit* begin, const CodeUnit* end, char*& output_end)
+    {
+        return utf16_to_utf8_sse42(begin, end, output_end);
+    }
+#endif
+};
+
+template<typename CodeUnit>
+struct unit_encoding<CodeUnit, 4>
+{
+    template<typename DecodingPolicy>
+    static CodeUnit* from_utf8(const char* begin, const char* end, CodeUnit* output, DecodingPolicy policy)
+    {
+        return utf8_to_utf32(begin, end, output, policy);
+    }
+
+    static char* to_utf8(const CodeUnit* begin, const CodeUnit* end, char* output)
+    {
+        return utf32_to_utf8(begin, end, output);
+    }
+
+#ifdef UNICPP_SIMD_X86
+    static const CodeUnit* to_utf8_sse42(const CodeUnit* begin, const CodeUnit* end, char*& output_end)
+    {
+        return utf32_to_utf8_sse42(begin, end, output_end);
+    }
+#endif
+};
+
+template<typename CodeUnit>
+CodeUnit* transcode_valid_from_utf8(const char* begin, const char* end, CodeUnit* output, simd_level level)
+{
+    const char* it = begin;
+
+#ifdef UNICPP_SIMD_X86
+    const unsigned char* octets = reinterpret_cast<const unsigned char*>(begin);
+    const unsigned char* octets_end = reinterpret_cast<const unsigned char*>(end);
+
+    if(level == simd_level::avx2)
+        octets = decode_utf8_avx2(octets, octets_end, output);
+    else if(level == simd_level::sse42)
+        octets = decode_utf8_sse42(octets, octets_end, output);
+
+    it = reinterpret_cast<const char*>(octets);
+#else
+    (void)level;
+#endif
+
+    return unit_encoding<CodeUnit>::from_utf8(it, end, output, trusted_decoding());
+}
+
+template<typename CodeUnit>
+CodeUnit* transcode_from_utf8(const char* begin, const char* end, CodeUnit* output, simd_level level)
+{
+    if(level == simd_level::scalar)
+        return unit_encoding<CodeUnit>::from_utf8(begin, end, output, strict_decoding());
+
+    // The kernels trust their input: they stop before the first error, which the scalar
+    // converter then reports as usual
+    const char* valid_end = begin + find_invalid_utf8(begin, end - begin, level);
+    output = transcode_valid_from_utf8(begin, valid_end, output, level);
+
+    return unit_encoding<CodeUnit>::from_utf8(valid_end, end, output, strict_decoding());
+}
+
+template<typename CodeUnit>
+char* transcode_to_utf8(const CodeUnit* begin, const CodeUnit* end, char* output, simd_level level)
+{
+    const CodeUnit* it = begin;
+
+#ifdef UNICPP_SIMD_X86
+    // The encoders only have 128 bits versions: their blocks need most of the vector registers,
+    // which the AVX2 code generated by GCC spends on reloading the constants
+    if(level != simd_level::scalar)
+        it = unit_encoding<CodeUnit>::to_utf8_sse42(it, end, output);
+#else
+    (void)level;
+#endif
+
+    return unit_encoding<CodeUnit>::to_utf8(it, end, output);
+}
+
+}
+
+char16_t* transcode_utf8_to_utf16(const char* begin, const char* end, char16_t* output)
+{
+    return transcode_utf8_to_utf16(begin, end, output, get_simd_level());
+}
+
+char16_t* transcode_utf8_to_utf16(const char* begin, const char* end, char16_t* output, simd_level level)
+{
+    return transcode_from_utf8(begin, end, output, level);
+}
+
+char16_t* transcode_valid_utf8_to_utf16(const char* begin, const char* end, char16_t* output)
+{
+    return transcode_valid_utf8_to_utf16(begin, end, output, get_simd_level());
+}
+
+char16_t* transcode_valid_utf8_to_utf16(const char* begin, const char* end, char16_t* output, simd_level level)
+{
+    return transcode_valid_from_utf8(begin, end, output, level);
+}
+
+char* transcode_utf16_to_utf8(const char16_t* begin, const char16_t* end, char* output)
+{
+    return transcode_utf16_to_utf8(begin, end, output, get_simd_level());
+}
+
+char* transcode_utf16_to_utf8(const char16_t* begin, const char16_t* end, char* output, simd_level level)
+{
+    return transcode_to_utf8(begin, end, output, level);
+}
+
+char32_t* transcode_utf8_to_utf32(const char* begin, const char* end, char32_t* output)
+{
+    return transcode_utf8_to_utf32(begin, end, output, get_simd_level());
+}
+
+char32_t* transcode_utf8_to_utf32(const char* begin, const char* end, char32_t* output, simd_level level)
+{
+    return transcode_from_utf8(begin, end, output, level);
+}
+
+char32_t* transcode_valid_utf8_to_utf32(const char* begin, const char* end, char32_t* output)
+{
+    return transcode_valid_utf8_to_utf32(begin, end, output, get_simd_level());
+}
+
+char32_t* transcode_valid_utf8_to_utf32(const char* begin, const char* end, char32_t* output, simd_level level)
+{
+    return transcode_valid_from_utf8(begin, end, output, level);
+}
+
+char* transcode_utf32_to_utf8(const char32_t* begin, const char32_t* end, char* output)
+{
+    return transcode_utf32_to_utf8(begin, end, output, get_simd_level());
+}
+
+char* transcode_utf32_to_utf8(const char32_t* begin, const char32_t* end, char* output, simd_level level)
+{
+    return transcode_to_utf8(begin, end, output, level);
+}
+
+wchar_t* transcode_utf8_to_wide(const char* begin, const char* end, wchar_t* output)
+{
+    return transcode_utf8_to_wide(begin, end, output, get_simd_level());
+}
+
+wchar_t* transcode_utf8_to_wide(const char* begin, const char* end, wchar_t* output, simd_level level)
+{
+    return transcode_from_utf8(begin, end, output, level);
+}
+
+char* transcode_wide_to_utf8(const wchar_t* begin, const wchar_t* end, char* output)
+{
+    return transcode_wide_to_utf8(begin, end, output, get_simd_level());
+}
+
+char* transcode_wide_to_utf8(const wchar_t* begin, const wchar_t* end, char* output, simd_level level)
+{
+    return transcode_to_utf8(begin, end, output, level);
+}
+
+}
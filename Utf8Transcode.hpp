@@ -0,0 +1,108 @@
+#ifndef UNICPP_UTF8TRANSCODE_H
+#define UNICPP_UTF8TRANSCODE_H
+
+#include <cstddef>
+
+#include "Utf8Simd.hpp"
+
+/**
+ * \file Contains the vectorized transcoders between UTF-8 and the other UTF encodings,
+ * working on contiguous buffers. They give the same results and throw the same exceptions
+ * as the converters of Utf8Tools.hpp, which handle the unusual sequences (and the errors).
+ * Used internally by unicpp::string.
+ */
+
+namespace unicpp
+{
+
+/**
+ * Same as utf8_to_utf16 (with strict_decoding). Returns the end of the output.
+ *
+ * output must be able to hold the result of the whole input (see utf16_length_from_utf8):
+ * the vectorized stores may write after the returned end, in that space.
+ */
+char16_t* transcode_utf8_to_utf16(const char* begin, const char* end, char16_t* output);
+
+/**
+ * Same as transcode_utf8_to_utf16 but forces the implementation to use.
+ */
+char16_t* transcode_utf8_to_utf16(const char* begin, const char* end, char16_t* output, simd_level level);
+
+/**
+ * Same as transcode_utf8_to_utf16 for an input known to be valid (see find_invalid_utf8),
+ * which is not checked again.
+ */
+char16_t* transcode_valid_utf8_to_utf16(const char* begin, const char* end, char16_t* output);
+
+/**
+ * Same as transcode_valid_utf8_to_utf16 but forces the implementation to use.
+ */
+char16_t* transcode_valid_utf8_to_utf16(const char* begin, const char* end, char16_t* output, simd_level level);
+
+/**
+ * Same as utf16_to_utf8. Returns the end of the output.
+ *
+ * output must be able to hold the result of the whole input (see utf8_length_from_utf16):
+ * the vectorized stores may write after the returned end, in that space.
+ */
+char* transcode_utf16_to_utf8(const char16_t* begin, const char16_t* end, char* output);
+
+/**
+ * Same as transcode_utf16_to_utf8 but forces the implementation to use.
+ */
+char* transcode_utf16_to_utf8(const char16_t* begin, const char16_t* end, char* output, simd_level level);
+
+/**
+ * Same as utf8_to_utf32 (with strict_decoding). Returns the end of the output.
+ *
+ * output must be able to hold the result of the whole input (see utf32_length_from_utf8):
+ * the vectorized stores may write after the returned end, in that space.
+ */
+char32_t* transcode_utf8_to_utf32(const char* begin, const char* end, char32_t* output);
+
+/**
+ * Same as transcode_utf8_to_utf32 but forces the implementation to use.
+ */
+char32_t* transcode_utf8_to_utf32(const char* begin, const char* end, char32_t* output, simd_level level);
+
+/**
+ * Same as transcode_utf8_to_utf32 for an input known to be valid (see find_invalid_utf8),
+ * which is not checked again.
+ */
+char32_t* transcode_valid_utf8_to_utf32(const char* begin, const char* end, char32_t* output);
+
+/**
+ * Same as transcode_valid_utf8_to_utf32 but forces the implementation to use.
+ */
+char32_t* transcode_valid_utf8_to_utf32(const char* begin, const char* end, char32_t* output, simd_level level);
+
+/**
+ * Same as utf32_to_utf8. Returns the end of the output.
+ *
+ * output must be able to hold the result of the whole input (see utf8_length_from_utf32):
+ * the vectorized stores may write after the returned end, in that space.
+ */
+char* transcode_utf32_to_utf8(const char32_t* begin, const char32_t* end, char* output);
+
+/**
+ * Same as transcode_utf32_to_utf8 but forces the implementation to use.
+ */
+char* transcode_utf32_to_utf8(const char32_t* begin, const char32_t* end, char* output, simd_level level);
+
+/**
+ * Same as transcode_utf8_to_utf32, or transcode_utf8_to_utf16 where wchar_t holds UTF-16
+ * (see WideEncoding.hpp), with the code units written as wchar_t.
+ */
+wchar_t* transcode_utf8_to_wide(const char* begin, const char* end, wchar_t* output);
+wchar_t* transcode_utf8_to_wide(const char* begin, const char* end, wchar_t* output, simd_level level);
+
+/**
+ * Same as transcode_utf32_to_utf8, or transcode_utf16_to_utf8 where wchar_t holds UTF-16,
+ * with the code units read as wchar_t.
+ */
+char* transcode_wide_to_utf8(const wchar_t* begin, const wchar_t* end, char* output);
+char* transcode_wide_to_utf8(const wchar_t* begin, const wchar_t* end, char* output, simd_level level);
+
+}
+
+#endif
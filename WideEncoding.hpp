@@ -0,0 +1,40 @@
+#ifndef UNICPP_WIDEENCODING_H
+#define UNICPP_WIDEENCODING_H
+
+#include <cstddef>
+
+#include "Utf8Tools.hpp"
+#include "Utf8Transcode.hpp"
+
+/**
+ * \file Contains the conversions of wchar_t strings, which hold UTF-32 on most platforms and
+ * UTF-16 on Windows: the wide strings are transcoded by transcode_utf8_to_wide and
+ * transcode_wide_to_utf8, with the bulk converters of the encoding with the same width.
+ * Used internally by unicpp::string and unicpp::string_view.
+ */
+
+namespace unicpp
+{
+
+template<std::size_t WcharSize>
+struct wide_encoding;
+
+template<>
+struct wide_encoding<4>
+{
+    static std::size_t length_from_utf8(const char* begin, const char* end) { return utf32_length_from_utf8(begin, end); }
+    static std::size_t utf8_length(const wchar_t* begin, const wchar_t* end) { return utf8_length_from_utf32(begin, end); }
+};
+
+template<>
+struct wide_encoding<2>
+{
+    static std::size_t length_from_utf8(const char* begin, const char* end) { return utf16_length_from_utf8(begin, end); }
+    static std::size_t utf8_length(const wchar_t* begin, const wchar_t* end) { return utf8_length_from_utf16(begin, end); }
+};
+
+using platform_wide_encoding = wide_encoding<sizeof(wchar_t)>;
+
+}
+
+#endif
@@ -0,0 +1,648 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../GraphemeSegmenter.hpp"
+#include "../MappedFile.hpp"
+#include "../String.hpp"
+#include "../StringView.hpp"
+#include "../Utf8Parallel.hpp"
+#include "../Utf8Simd.hpp"
+#include "../Utf8Stream.hpp"
+#include "../Utf8Tools.hpp"
+#include "../Utf8Transcode.hpp"
+
+#include "Corpora.hpp"
+#include "Harness.hpp"
+
+/*
+ * unicpp_bench [--filter=TEXT] [--size=OCTETS] [--seed=N] [--warmup=N] [--repetitions=N] [--threads=N] [--json=FILE|-]
+ *
+ * Times the public operations of unicpp over the generated corpora (see make_corpora), and prints a table
+ * followed by the UTF-32 transcoding throughput of every corpus in GB/s (or writes the results as JSON to FILE,
+ * or to the standard output with "-").
+ * The parallel scans run with 1, 2, 4... threads, up to --threads (by default, the number of hardware threads).
+ */
+
+namespace
+{
+
+using unicpp::bench::corpus;
+using unicpp::bench::harness;
+
+const std::size_t DEFAULT_CORPUS_SIZE = 1024 * 1024;
+const std::size_t RANDOM_ACCESSES = 1000;
+const std::size_t PARALLEL_BUFFER_SIZE = 16 * 1024 * 1024;
+
+struct levelled
+{
+    unicpp::simd_level level;
+    const char* suffix;
+};
+
+std::vector<levelled> supported_levels()
+{
+    std::vector<levelled> levels{{unicpp::simd_level::scalar, " (scalar)"}};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back({unicpp::simd_level::sse42, " (SSE4.2)"});
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back({unicpp::simd_level::avx2, " (AVX2)"});
+
+    return levels;
+}
+
+// Out-of-line predicates, as they were defined in Utf8Tools.cpp before being made constexpr
+__attribute__((noinline)) bool legacy_is_valid_utf8_octet(unsigned char octet)
+{
+    return octet != 0xC0 && octet != 0xC1 && octet != 0xF5 && octet != 0xFF;
+}
+
+__attribute__((noinline)) std::size_t legacy_get_lead_octet_sequence_length(unsigned char octet)
+{
+    if(octet <= 127)
+        return 1;
+    else if((octet >> 5) == 0x6)
+        return 2;
+    else if((octet >> 4) == 0xE)
+        return 3;
+    else if((octet >> 3) == 0x1E)
+        return 4;
+    else
+        return 0;
+}
+
+__attribute__((noinline)) bool legacy_is_trail_octet(unsigned char octet)
+{
+    return ((octet >> 6) == 0x2);
+}
+
+// Sequence based decoding, as done before the DFA
+unicpp::utf8_decode_result legacy_decode_next(const char*& it, const char* end)
+{
+    if(it != end && unicpp::is_ascii(*it))
+    {
+        char32_t codepoint = static_cast<unsigned char>(*it++);
+        return unicpp::utf8_decode_result{unicpp::utf8_status::ok, codepoint, 1};
+    }
+
+    unsigned char buffer[4];
+    unicpp::utf8_decode_result result = unicpp::decode_next_sequence(it, end, buffer);
+    if(result.status != unicpp::utf8_status::ok)
+        return result;
+
+    const unsigned char masks[] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+    char32_t codepoint = buffer[0] & masks[result.length];
+    for(std::size_t i = 1; i < result.length; ++i)
+        codepoint = (codepoint << 6) | (buffer[i] & 0x3F);
+
+    result.codepoint = codepoint;
+    if(!unicpp::is_valid_codepoint(codepoint))
+        result.status = unicpp::utf8_status::invalid_codepoint;
+
+    return result;
+}
+
+void bench_construction(harness& h, const corpus& c, const unicpp::string& str)
+{
+    const std::string& data = c.data;
+    std::size_t codepoints = str.codepoints_count();
+    std::u16string utf16 = str.utf16_str();
+    std::u32string utf32 = str.utf32_str();
+    std::wstring wide = str.w_str();
+
+    h.run(c.name, "string(const char*, size)", data.size(), codepoints, [&]() {
+        return unicpp::string(data.data(), data.size()).std_str().size();
+    });
+    h.run(c.name, "string(u16string)", data.size(), codepoints, [&]() {
+        return unicpp::string(utf16).std_str().size();
+    });
+    h.run(c.name, "string(u32string)", data.size(), codepoints, [&]() {
+        return unicpp::string(utf32).std_str().size();
+    });
+    h.run(c.name, "string(wstring)", data.size(), codepoints, [&]() {
+        return unicpp::string(wide).std_str().size();
+    });
+
+    // A parser handing out the lines of the corpus, copied or viewed
+    std::vector<std::pair<std::size_t, std::size_t>> lines;
+    for(std::size_t begin = 0; begin < data.size(); )
+    {
+        std::size_t end = std::min(data.find('\n', begin), data.size());
+        lines.emplace_back(begin, end - begin);
+        begin = end + 1;
+    }
+
+    h.run(c.name, "lines as string", data.size(), lines.size(), [&]() {
+        std::size_t sum = 0;
+        for(const auto& line : lines)
+            sum += unicpp::string(data.data() + line.first, line.second).codepoints_count();
+        return sum;
+    });
+    h.run(c.name, "lines as string_view", data.size(), lines.size(), [&]() {
+        std::size_t sum = 0;
+        for(const auto& line : lines)
+            sum += unicpp::string_view(data.data() + line.first, line.second).codepoints_count();
+        return sum;
+    });
+}
+
+void bench_conversion(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+    std::u16string buffer16;
+    std::u32string buffer32;
+
+    h.run(c.name, "utf16_str", bytes, codepoints, [&]() { return str.utf16_str().size(); });
+    h.run(c.name, "utf32_str", bytes, codepoints, [&]() { return str.utf32_str().size(); });
+    h.run(c.name, "w_str", bytes, codepoints, [&]() { return str.w_str().size(); });
+    h.run(c.name, "utf16_str (lossy)", bytes, codepoints, [&]() {
+        return str.utf16_str(unicpp::lossy_decoding()).size();
+    });
+    h.run(c.name, "utf32_str (lossy)", bytes, codepoints, [&]() {
+        return str.utf32_str(unicpp::lossy_decoding()).size();
+    });
+    h.run(c.name, "utf16_into", bytes, codepoints, [&]() {
+        str.utf16_into(buffer16);
+        return buffer16.size();
+    });
+    h.run(c.name, "utf32_into", bytes, codepoints, [&]() {
+        str.utf32_into(buffer32);
+        return buffer32.size();
+    });
+    // Chunks of an odd size, to cut sequences
+    unicpp::utf8_stream_decoder decoder;
+    std::u32string chunk_buffer(4093, U'\0');
+    h.run(c.name, "utf8_stream_decoder::decode (4093 octet chunks)", bytes, codepoints, [&]() {
+        const std::size_t chunk = chunk_buffer.size();
+        std::size_t count = 0;
+        decoder.reset();
+        for(std::size_t i = 0; i < c.data.size(); i += chunk)
+            count += decoder.decode(c.data.data() + i, std::min(chunk, c.data.size() - i), &chunk_buffer[0]) - chunk_buffer.data();
+        return decoder.finish() ? count : 0;
+    });
+}
+
+void bench_validation(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+
+    // One invalid octet every 4KiB
+    std::string dirty_data = c.data;
+    for(std::size_t i = 0; i < dirty_data.size(); i += 4096)
+        dirty_data[i] = '\xFF';
+    unicpp::string dirty(dirty_data.data(), dirty_data.size());
+
+    h.run(c.name, "is_valid", bytes, codepoints, [&]() { return str.is_valid(); });
+    h.run(c.name, "sanitized (clean)", bytes, codepoints, [&]() { return str.sanitized().std_str().size(); });
+    h.run(c.name, "sanitized (dirty)", bytes, codepoints, [&]() { return dirty.sanitized().std_str().size(); });
+    unicpp::utf8_stream_decoder decoder;
+    h.run(c.name, "utf8_stream_decoder::validate (4093 octet chunks)", bytes, codepoints, [&]() {
+        const std::size_t chunk = 4093;
+        decoder.reset();
+        for(std::size_t i = 0; i < c.data.size(); i += chunk)
+            decoder.validate(c.data.data() + i, std::min(chunk, c.data.size() - i));
+        return decoder.finish();
+    });
+}
+
+void bench_iteration(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+    std::size_t graphemes = str.graphemes_count();
+
+    h.run(c.name, "codepoint iteration (strict)", bytes, codepoints, [&]() {
+        char32_t sum = 0;
+        for(auto it = str.cbegin(); it != str.cend(); ++it)
+            sum += *it;
+        return sum;
+    });
+    h.run(c.name, "codepoint iteration (lossy)", bytes, codepoints, [&]() {
+        char32_t sum = 0;
+        for(auto it = str.cbegin(unicpp::lossy_decoding()); it != str.cend(unicpp::lossy_decoding()); ++it)
+            sum += *it;
+        return sum;
+    });
+    h.run(c.name, "codepoint iteration (trusted)", bytes, codepoints, [&]() {
+        char32_t sum = 0;
+        for(auto it = str.cbegin(unicpp::trusted_decoding()); it != str.cend(unicpp::trusted_decoding()); ++it)
+            sum += *it;
+        return sum;
+    });
+    // The reverse iterators go from crend() (the last codepoint) to crbegin()
+    h.run(c.name, "codepoint iteration (reverse)", bytes, codepoints, [&]() {
+        char32_t sum = 0;
+        for(auto it = str.crend(); it != str.crbegin(); ++it)
+            sum += *it;
+        return sum;
+    });
+    h.run(c.name, "grapheme iteration", bytes, graphemes, [&]() {
+        std::size_t sum = 0;
+        for(auto it = str.gbegin(); it != str.gend(); ++it)
+            sum += (*it).octets_count();
+        return sum;
+    });
+    unicpp::grapheme_segmenter segmenter;
+    std::vector<std::uint64_t> boundaries;
+    h.run(c.name, "grapheme_segmenter (4KiB chunks)", bytes, graphemes, [&]() {
+        const std::size_t chunk = 4096;
+        std::size_t count = 0;
+        for(std::size_t i = 0; i < c.data.size(); i += chunk)
+        {
+            boundaries.clear();
+            count += segmenter.feed(c.data.data() + i, std::min(chunk, c.data.size() - i), boundaries);
+        }
+        return count + segmenter.finish(boundaries);
+    });
+    h.run(c.name, "grapheme_view::to_grapheme", bytes, graphemes, [&]() {
+        std::size_t sum = 0;
+        for(auto it = str.gbegin(); it != str.gend(); ++it)
+            sum += (*it).to_grapheme().codepoints_count();
+        return sum;
+    });
+    h.run(c.name, "grapheme::get_casefold", bytes, graphemes, [&]() {
+        std::size_t sum = 0;
+        for(auto it = str.gbegin(); it != str.gend(); ++it)
+            sum += (*it).to_grapheme().get_casefold().codepoints_count();
+        return sum;
+    });
+}
+
+void bench_counting(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+    std::size_t graphemes = str.graphemes_count();
+
+    // Going through modify() drops the cached counts and indexes, so that they are computed again
+    unicpp::string uncached(str);
+
+    h.run(c.name, "size<as_codepoints> (uncached)", bytes, codepoints, [&]() {
+        uncached.modify([](std::string&) {});
+        return uncached.size<unicpp::as_codepoints>();
+    });
+    h.run(c.name, "size<as_graphemes> (uncached)", bytes, graphemes, [&]() {
+        uncached.modify([](std::string&) {});
+        return uncached.size<unicpp::as_graphemes>();
+    });
+    h.run(c.name, "size<as_codepoints> (cached)", bytes, codepoints, [&]() {
+        return str.size<unicpp::as_codepoints>();
+    });
+    h.run(c.name, "build_codepoint_index", bytes, codepoints, [&]() {
+        uncached.modify([](std::string&) {});
+        uncached.build_codepoint_index();
+        return uncached.has_codepoint_index();
+    });
+    h.run(c.name, "build_grapheme_index", bytes, graphemes, [&]() {
+        uncached.modify([](std::string&) {});
+        uncached.build_grapheme_index();
+        return uncached.has_grapheme_index();
+    });
+}
+
+void bench_random_access(harness& h, const corpus& c, const unicpp::string& str)
+{
+    unicpp::string indexed(str);
+    indexed.build_codepoint_index();
+    indexed.build_grapheme_index();
+
+    std::mt19937 generator(42);
+    std::vector<std::size_t> codepoint_positions, grapheme_positions;
+    for(std::size_t i = 0; i < RANDOM_ACCESSES; ++i)
+    {
+        codepoint_positions.push_back(generator() % str.codepoints_count());
+        grapheme_positions.push_back(generator() % str.graphemes_count());
+    }
+
+    h.run(c.name, "at (indexed)", 0, RANDOM_ACCESSES, [&]() {
+        char32_t sum = 0;
+        for(std::size_t n : codepoint_positions)
+            sum += indexed.at(n);
+        return sum;
+    });
+    h.run(c.name, "nth_grapheme (indexed)", 0, RANDOM_ACCESSES, [&]() {
+        std::size_t sum = 0;
+        for(std::size_t n : grapheme_positions)
+            sum += (*indexed.nth_grapheme(n)).octets_count();
+        return sum;
+    });
+    h.run(c.name, "codepoint_index (indexed)", 0, RANDOM_ACCESSES, [&]() {
+        std::size_t sum = 0;
+        for(std::size_t n : codepoint_positions)
+            sum += indexed.codepoint_index(indexed.codepoint_offset(n));
+        return sum;
+    });
+    h.run(c.name, "substr (indexed)", 0, RANDOM_ACCESSES, [&]() {
+        std::size_t sum = 0;
+        for(std::size_t n : codepoint_positions)
+            sum += indexed.substr(n, 16).std_str().size();
+        return sum;
+    });
+}
+
+void bench_modification(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+    unicpp::string word(u8"naïve ");
+
+    h.run(c.name, "append", bytes, codepoints, [&]() {
+        unicpp::string result;
+        result.append(str);
+        return result.std_str().size();
+    });
+    h.run(c.name, "copy + replace", bytes, codepoints, [&]() {
+        unicpp::string result(str);
+        result.replace(codepoints / 2, 8, word);
+        return result.std_str().size();
+    });
+}
+
+void bench_kernels(harness& h, const corpus& c, const unicpp::string& str)
+{
+    const std::string& data = c.data;
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    std::size_t codepoints = str.codepoints_count();
+
+    std::u16string utf16 = str.utf16_str();
+    std::u32string utf32 = str.utf32_str();
+    std::u16string buffer16(utf16.size(), u'\0');
+    std::u32string buffer32(utf32.size(), U'\0');
+    std::string buffer8(data.size(), '\0');
+    std::vector<std::size_t> offsets;
+
+    h.run(c.name, "is_valid_utf8", data.size(), codepoints, [&]() {
+        return unicpp::is_valid_utf8(begin, end);
+    });
+    h.run(c.name, "decode_next", data.size(), codepoints, [&]() {
+        char32_t sum = 0;
+        for(const char* it = begin; it != end; )
+            sum += unicpp::decode_next(it, end).codepoint;
+        return sum;
+    });
+
+    for(const levelled& l : supported_levels())
+    {
+        std::string suffix = l.suffix;
+
+        h.run(c.name, "validate_utf8" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::validate_utf8(begin, data.size(), l.level);
+        });
+        h.run(c.name, "find_invalid_utf8" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::find_invalid_utf8(begin, data.size(), l.level);
+        });
+        h.run(c.name, "count_utf8_codepoints" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::count_utf8_codepoints(begin, data.size(), l.level);
+        });
+        h.run(c.name, "index_utf8_codepoints" + suffix, data.size(), codepoints, [&]() {
+            offsets.clear();
+            return unicpp::index_utf8_codepoints(begin, data.size(), 0, unicpp::string::CODEPOINT_INDEX_STRIDE, offsets, l.level);
+        });
+        h.run(c.name, "transcode_utf8_to_utf16" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::transcode_utf8_to_utf16(begin, end, &buffer16[0], l.level) - &buffer16[0];
+        });
+        h.run(c.name, "transcode_utf8_to_utf32" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::transcode_utf8_to_utf32(begin, end, &buffer32[0], l.level) - &buffer32[0];
+        });
+        h.run(c.name, "transcode_utf16_to_utf8" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::transcode_utf16_to_utf8(utf16.data(), utf16.data() + utf16.size(), &buffer8[0], l.level) - &buffer8[0];
+        });
+        h.run(c.name, "transcode_utf32_to_utf8" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::transcode_utf32_to_utf8(utf32.data(), utf32.data() + utf32.size(), &buffer8[0], l.level) - &buffer8[0];
+        });
+    }
+}
+
+// Compares the decoding primitives with the implementations they replaced
+void bench_legacy(harness& h, const corpus& c, const unicpp::string& str)
+{
+    const std::size_t bytes = c.data.size();
+    const std::size_t codepoints = str.codepoints_count();
+    const char* begin = c.data.data();
+    const char* end = begin + bytes;
+    const unsigned char* octets_begin = reinterpret_cast<const unsigned char*>(begin);
+    const unsigned char* octets_end = octets_begin + bytes;
+
+    // Classifies every octet the way decode_next_sequence does
+    h.run(c.name, "octet predicates (out-of-line)", bytes, bytes, [&]() {
+        std::size_t sum = 0;
+        for(auto it = octets_begin; it != octets_end; ++it)
+            sum += legacy_is_valid_utf8_octet(*it) + legacy_get_lead_octet_sequence_length(*it) + legacy_is_trail_octet(*it);
+        return sum;
+    });
+    h.run(c.name, "octet predicates (constexpr tables)", bytes, bytes, [&]() {
+        std::size_t sum = 0;
+        for(auto it = octets_begin; it != octets_end; ++it)
+            sum += unicpp::is_valid_utf8_octet(*it) + unicpp::get_lead_octet_sequence_length(*it) + unicpp::is_trail_octet(*it);
+        return sum;
+    });
+    h.run(c.name, "decode_next_sequence", bytes, codepoints, [&]() {
+        std::size_t sum = 0;
+        unsigned char buffer[4];
+        for(auto it = octets_begin; it != octets_end; )
+            sum += unicpp::decode_next_sequence(it, octets_end, buffer).length;
+        return sum;
+    });
+    h.run(c.name, "decode_next (sequence based)", bytes, codepoints, [&]() {
+        char32_t sum = 0;
+        for(const char* it = begin; it != end; )
+            sum += legacy_decode_next(it, end).codepoint;
+        return sum;
+    });
+}
+
+void bench_files(harness& h, const corpus& c, const unicpp::string& str)
+{
+    std::size_t bytes = c.data.size();
+    std::size_t codepoints = str.codepoints_count();
+
+    // The file stays in the page cache: this measures the copy avoided by the mapping, not the disk
+    const std::string path = "unicpp_bench_" + c.name + ".txt";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(c.data.data(), c.data.size());
+    }
+
+    h.run(c.name, "read file + string::is_valid", bytes, codepoints, [&]() {
+        std::ifstream file(path, std::ios::binary);
+        std::string content(bytes, '\0');
+        file.read(&content[0], content.size());
+        return unicpp::string(content.data(), content.size()).is_valid();
+    });
+    h.run(c.name, "mapped_file + string_view::is_valid", bytes, codepoints, [&]() {
+        return unicpp::mapped_file(path).view().is_valid();
+    });
+    h.run(c.name, "mapped_file + string_view::codepoints_count", bytes, codepoints, [&]() {
+        return unicpp::mapped_file(path).view().codepoints_count();
+    });
+
+    std::remove(path.c_str());
+}
+
+void bench_parallel(harness& h, const corpus& c, std::size_t max_threads)
+{
+    // Large enough for every thread to get several chunks of PARALLEL_MIN_CHUNK_SIZE
+    std::string data;
+    while(data.size() < PARALLEL_BUFFER_SIZE)
+        data += c.data;
+    std::size_t codepoints = unicpp::count_utf8_codepoints(data.data(), data.size());
+
+    for(std::size_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+        std::string suffix = " (" + std::to_string(threads) + (threads == 1 ? " thread)" : " threads)");
+
+        h.run(c.name, "validate_utf8_parallel" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::validate_utf8_parallel(data.data(), data.size(), threads);
+        });
+        h.run(c.name, "count_utf8_codepoints_parallel" + suffix, data.size(), codepoints, [&]() {
+            return unicpp::count_utf8_codepoints_parallel(data.data(), data.size(), threads);
+        });
+
+        if(threads == max_threads)
+            break;
+    }
+}
+
+/**
+ * Writes the UTF-32 transcoding throughputs of every corpus in GB/s of UTF-8, at the best
+ * supported level, with the scalar kernels and through unicpp::string ("-" if filtered out).
+ */
+void write_transcoding_summary(std::ostream& output, const harness& h, const std::vector<corpus>& corpora)
+{
+    const std::string best = supported_levels().back().suffix;
+    auto throughput = [&](const std::string& corpus_name, const std::string& name) {
+        std::ostringstream gigabytes_per_second;
+        gigabytes_per_second << std::setprecision(3) << '-';
+        for(const unicpp::bench::result& r : h.results())
+        {
+            if(r.corpus == corpus_name && r.name == name)
+            {
+                gigabytes_per_second.str("");
+                gigabytes_per_second << r.bytes_per_second() / 1e9;
+            }
+        }
+        return gigabytes_per_second.str();
+    };
+
+    output << "Throughput per script family, in GB/s of UTF-8 (" << best.substr(2, best.size() - 3) << "):\n";
+    for(const corpus& c : corpora)
+    {
+        output << "  " << c.name << ": UTF-8 to UTF-32 " << throughput(c.name, "transcode_utf8_to_utf32" + best)
+            << " (scalar " << throughput(c.name, "transcode_utf8_to_utf32 (scalar)")
+            << ", utf32_into " << throughput(c.name, "utf32_into")
+            << "), UTF-32 to UTF-8 " << throughput(c.name, "transcode_utf32_to_utf8" + best)
+            << " (scalar " << throughput(c.name, "transcode_utf32_to_utf8 (scalar)")
+            << ", constructor " << throughput(c.name, "string(u32string)") << ")\n";
+    }
+    output << std::flush;
+}
+
+template<typename Unsigned>
+bool parse_unsigned(const std::string& value, Unsigned& result)
+{
+    char* end = nullptr;
+    unsigned long long parsed = std::strtoull(value.c_str(), &end, 10);
+    if(value.empty() || *end != '\0')
+        return false;
+
+    result = static_cast<Unsigned>(parsed);
+    return true;
+}
+
+void print_usage()
+{
+    std::cerr << "Usage: unicpp_bench [--filter=TEXT] [--size=OCTETS] [--seed=N] [--warmup=N] [--repetitions=N] [--threads=N] [--json=FILE|-]\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unicpp::bench::options opts;
+    std::size_t corpus_size = DEFAULT_CORPUS_SIZE;
+    std::uint64_t seed = unicpp::bench::DEFAULT_SEED;
+    std::string json_path;
+    std::size_t max_threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::string::size_type equal = arg.find('=');
+        std::string key = arg.substr(0, equal);
+        std::string value = (equal == std::string::npos) ? "" : arg.substr(equal + 1);
+
+        bool ok = true;
+        if(key == "--filter")
+            opts.filter = value;
+        else if(key == "--size")
+            ok = parse_unsigned(value, corpus_size) && corpus_size > 0;
+        else if(key == "--seed")
+            ok = parse_unsigned(value, seed);
+        else if(key == "--warmup")
+            ok = parse_unsigned(value, opts.warmup);
+        else if(key == "--repetitions")
+            ok = parse_unsigned(value, opts.repetitions) && opts.repetitions > 0;
+        else if(key == "--threads")
+            ok = parse_unsigned(value, max_threads) && max_threads > 0;
+        else if(key == "--json")
+            ok = !(json_path = value).empty();
+        else
+            ok = false;
+
+        if(!ok)
+        {
+            print_usage();
+            return 1;
+        }
+    }
+
+    harness h(opts);
+    const std::vector<corpus> corpora = unicpp::bench::make_corpora(corpus_size, seed);
+    for(const corpus& c : corpora)
+    {
+        unicpp::string str(c.data.data(), c.data.size());
+
+        bench_construction(h, c, str);
+        bench_conversion(h, c, str);
+        bench_validation(h, c, str);
+        bench_iteration(h, c, str);
+        bench_counting(h, c, str);
+        bench_random_access(h, c, str);
+        bench_modification(h, c, str);
+        bench_kernels(h, c, str);
+        bench_legacy(h, c, str);
+        bench_files(h, c, str);
+        bench_parallel(h, c, max_threads);
+    }
+
+    if(json_path == "-")
+        h.write_json(std::cout);
+    else
+    {
+        h.write_text(std::cout);
+        write_transcoding_summary(std::cout, h, corpora);
+        if(!json_path.empty())
+        {
+            std::ofstream json(json_path);
+            h.write_json(json);
+            if(!json)
+            {
+                std::cerr << "Could not write " << json_path << "\n";
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
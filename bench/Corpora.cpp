@@ -0,0 +1,295 @@
+#include "Corpora.hpp"
+
+#include <iterator>
+#include <stdexcept>
+
+#include "../Utf8Tools.hpp"
+
+namespace unicpp
+{
+namespace bench
+{
+
+namespace
+{
+
+/**
+ * splitmix64: the standard distributions are implemented differently by each standard
+ * library, the corpora only use this generator to be the same everywhere.
+ */
+class random_generator
+{
+public:
+    explicit random_generator(std::uint64_t seed) : m_state(seed) {}
+
+    std::uint64_t next()
+    {
+        std::uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    /**
+     * Returns a number in [0, bound).
+     */
+    std::uint32_t below(std::uint32_t bound)
+    {
+        return static_cast<std::uint32_t>(((next() >> 32) * bound) >> 32);
+    }
+
+    char32_t in_range(char32_t first, char32_t last)
+    {
+        return first + below(last - first + 1);
+    }
+
+    bool chance(double probability)
+    {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0) < probability;
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+// The letters of English text, roughly with their frequency
+const char ENGLISH_LETTERS[] =
+    "eeeeeeeeeeeettttttttttaaaaaaaaooooooooiiiiiiinnnnnnnsssssshhhhhhrrrrrrdddd"
+    "lllllcccuuummmwwffggyyppbbvkjxqz";
+
+// The invalid sequences that decode_next rejects, one of each kind of error
+const char* const INVALID_SEQUENCES[] = {
+    "\x80",             // Stray continuation octet
+    "\xBF\xBF",
+    "\xE2\x82",         // Truncated sequences
+    "\xF0\x9F\x98",
+    "\xC0\xAF",         // Invalid octets (overlong 2-octet forms)
+    "\xFF",
+    "\xED\xA0\x80",     // Surrogate
+    "\xEF\xBF\xBE",     // Noncharacter U+FFFE
+    "\xF4\x90\x80\x80"  // Above U+10FFFF
+};
+
+class corpus_writer
+{
+public:
+    corpus_writer(const corpus_profile& profile, std::uint64_t seed, std::string& output) :
+        m_profile(profile),
+        m_random(seed),
+        m_output(output)
+    {
+        for(const script_weight& s : profile.scripts)
+            m_total_weight += s.weight;
+    }
+
+    void write_word()
+    {
+        script which = pick_script();
+        std::size_t letters = (which == script::cjk || which == script::hangul) ? 1 + m_random.below(4) : 2 + m_random.below(8);
+
+        for(std::size_t i = 0; i < letters; ++i)
+        {
+            put(letter(which, i == 0));
+            if(which != script::cjk && which != script::hangul && m_random.chance(m_profile.combining_marks))
+            {
+                std::uint32_t marks = 1 + m_random.below(3);
+                for(std::uint32_t j = 0; j < marks; ++j)
+                    put(m_random.in_range(0x0300, 0x036F));
+            }
+        }
+
+        if(m_random.chance(m_profile.emoji_sequences))
+        {
+            put(' ');
+            write_emoji_sequence();
+        }
+
+        write_separator(which);
+    }
+
+private:
+    script pick_script()
+    {
+        if(m_profile.scripts.empty())
+            return script::ascii;
+
+        double target = static_cast<double>(m_random.next() >> 11) * (1.0 / 9007199254740992.0) * m_total_weight;
+        for(const script_weight& s : m_profile.scripts)
+        {
+            if(target < s.weight)
+                return s.which;
+            target -= s.weight;
+        }
+
+        return m_profile.scripts.back().which;
+    }
+
+    char32_t letter(script which, bool first)
+    {
+        char32_t ascii = ENGLISH_LETTERS[m_random.below(sizeof(ENGLISH_LETTERS) - 1)];
+        if(first && m_random.chance(0.2))
+            ascii -= 'a' - 'A';
+
+        switch(which)
+        {
+        case script::latin1:
+        {
+            if(!m_random.chance(0.2))
+                return ascii;
+            // U+00D7 and U+00F7 are the multiplication and division signs
+            char32_t codepoint = m_random.in_range(0x00C0, 0x00FF);
+            return (codepoint == 0x00D7 || codepoint == 0x00F7) ? codepoint + 1 : codepoint;
+        }
+        case script::greek:
+            return m_random.in_range(0x03B1, 0x03C9);
+        case script::cyrillic:
+            return m_random.in_range(0x0430, 0x044F);
+        case script::cjk:
+            return m_random.chance(0.3) ? m_random.in_range(0x3041, 0x3096) : m_random.in_range(0x4E00, 0x9FFF);
+        case script::hangul:
+            return m_random.in_range(0xAC00, 0xD7A3);
+        default:
+            return ascii;
+        }
+    }
+
+    void write_emoji_sequence()
+    {
+        switch(m_random.below(5))
+        {
+        case 0:
+            put(m_random.in_range(0x1F600, 0x1F64F));
+            break;
+        case 1: // Skin tone modifier
+            put(m_random.in_range(0x1F446, 0x1F450));
+            put(m_random.in_range(0x1F3FB, 0x1F3FF));
+            break;
+        case 2: // Flag
+            put(m_random.in_range(0x1F1E6, 0x1F1FF));
+            put(m_random.in_range(0x1F1E6, 0x1F1FF));
+            break;
+        case 3: // Keycap
+            put(m_random.in_range('0', '9'));
+            put(0xFE0F);
+            put(0x20E3);
+            break;
+        default: // Family
+        {
+            std::uint32_t members = 2 + m_random.below(3);
+            for(std::uint32_t i = 0; i < members; ++i)
+            {
+                if(i > 0)
+                    put(0x200D);
+                put(m_random.in_range(0x1F466, 0x1F469));
+            }
+        }
+        }
+    }
+
+    void write_separator(script which)
+    {
+        if(m_random.chance(0.02))
+        {
+            put('\n');
+            return;
+        }
+
+        if(which == script::cjk)
+        {
+            if(m_random.chance(0.1))
+                put(m_random.chance(0.5) ? 0x3002 : 0xFF0C);
+            return;
+        }
+
+        if(m_random.chance(0.08))
+            put(m_random.chance(0.6) ? ',' : '.');
+        put(' ');
+    }
+
+    void put(char32_t codepoint)
+    {
+        if(m_random.chance(m_profile.invalid_sequences))
+            m_output += INVALID_SEQUENCES[m_random.below(sizeof(INVALID_SEQUENCES) / sizeof(INVALID_SEQUENCES[0]))];
+
+        codepoint_to_utf8(codepoint, std::back_inserter(m_output));
+    }
+
+    const corpus_profile& m_profile;
+    random_generator m_random;
+    std::string& m_output;
+    double m_total_weight = 0;
+};
+
+struct named_profile
+{
+    const char* name;
+    corpus_profile profile;
+};
+
+const std::vector<named_profile>& get_profiles()
+{
+    static const std::vector<named_profile> profiles{
+        {"ascii", {{{script::ascii, 1}}, 0, 0, 0}},
+        {"latin1", {{{script::latin1, 1}}, 0, 0, 0}},
+        {"cjk", {{{script::cjk, 0.9}, {script::ascii, 0.1}}, 0, 0, 0}},
+        {"hangul", {{{script::hangul, 0.9}, {script::ascii, 0.1}}, 0, 0, 0}},
+        {"emoji", {{{script::ascii, 1}}, 0, 0.5, 0}},
+        {"combining", {{{script::latin1, 0.6}, {script::greek, 0.2}, {script::cyrillic, 0.2}}, 0.4, 0, 0}},
+        {"mixed", {{{script::ascii, 0.4}, {script::latin1, 0.2}, {script::cyrillic, 0.1}, {script::cjk, 0.15},
+            {script::hangul, 0.15}}, 0.02, 0.05, 0}},
+        {"dirty", {{{script::ascii, 0.4}, {script::latin1, 0.2}, {script::cyrillic, 0.1}, {script::cjk, 0.15},
+            {script::hangul, 0.15}}, 0.02, 0.05, 0.001}}
+    };
+
+    return profiles;
+}
+
+}
+
+std::vector<std::string> profile_names()
+{
+    std::vector<std::string> names;
+    for(const named_profile& p : get_profiles())
+        names.push_back(p.name);
+
+    return names;
+}
+
+corpus_profile get_profile(const std::string& name)
+{
+    for(const named_profile& p : get_profiles())
+    {
+        if(name == p.name)
+            return p.profile;
+    }
+
+    throw std::invalid_argument("Unknown corpus profile: " + name);
+}
+
+std::string generate_corpus(const corpus_profile& profile, std::uint64_t seed, std::size_t size)
+{
+    std::string output;
+    output.reserve(size + 64);
+
+    corpus_writer writer(profile, seed, output);
+    while(output.size() < size)
+        writer.write_word();
+
+    return output;
+}
+
+std::vector<corpus> make_corpora(std::size_t size, std::uint64_t seed)
+{
+    return {
+        {"ASCII", generate_corpus(get_profile("ascii"), seed, size)},
+        {"Latin1", generate_corpus(get_profile("latin1"), seed, size)},
+        {"CJK", generate_corpus(get_profile("cjk"), seed, size)},
+        {"Hangul", generate_corpus(get_profile("hangul"), seed, size)},
+        {"EmojiZWJ", generate_corpus(get_profile("emoji"), seed, size)},
+        {"Combining", generate_corpus(get_profile("combining"), seed, size)},
+        {"Mixed", generate_corpus(get_profile("mixed"), seed, size)}
+    };
+}
+
+}
+}
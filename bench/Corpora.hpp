@@ -0,0 +1,89 @@
+#ifndef UNICPP_BENCH_CORPORA_H
+#define UNICPP_BENCH_CORPORA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \file Contains the corpora of the benchmarks and their generator. The corpora are
+ * synthesized from a seed, so the benchmarks do not need any data file nor network
+ * access and give the same input on every machine.
+ */
+
+namespace unicpp
+{
+namespace bench
+{
+
+enum class script
+{
+    ascii,
+    latin1,     // ASCII and the letters of U+00C0..U+00FF
+    greek,
+    cyrillic,
+    cjk,        // Han ideographs and kana, without spaces between the words
+    hangul
+};
+
+struct script_weight
+{
+    script which;
+    double weight;
+};
+
+/**
+ * Describes the text produced by generate_corpus (the probabilities are between 0 and 1).
+ */
+struct corpus_profile
+{
+    // Relative frequency of the scripts of the words
+    std::vector<script_weight> scripts;
+
+    // Probability that a letter carries one to three combining marks
+    double combining_marks;
+
+    // Probability that a word is followed by an emoji (modifier, flag, keycap or ZWJ) sequence
+    double emoji_sequences;
+
+    // Probability that an invalid sequence (stray continuation octet, truncated or overlong
+    // sequence, surrogate, invalid octet) is inserted before a codepoint
+    double invalid_sequences;
+};
+
+/**
+ * Returns the names of the predefined profiles (see get_profile).
+ */
+std::vector<std::string> profile_names();
+
+/**
+ * Returns a predefined profile, throws std::invalid_argument if name is unknown.
+ */
+corpus_profile get_profile(const std::string& name);
+
+/**
+ * Returns a text of at least size octets following profile. The text only depends on
+ * the profile, the seed and the size (not on the platform nor on the standard library),
+ * and is valid UTF-8 if profile.invalid_sequences is 0.
+ */
+std::string generate_corpus(const corpus_profile& profile, std::uint64_t seed, std::size_t size);
+
+struct corpus
+{
+    std::string name;
+    std::string data;
+};
+
+const std::uint64_t DEFAULT_SEED = 20170101;
+
+/**
+ * Returns the corpora of unicpp_bench, each one being valid UTF-8 of at least size octets:
+ * ASCII, Latin-1 range, CJK, Hangul, emoji ZWJ sequences, combining marks and a mix of them.
+ */
+std::vector<corpus> make_corpora(std::size_t size, std::uint64_t seed = DEFAULT_SEED);
+
+}
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "Corpora.hpp"
+
+/*
+ * unicpp_corpus [--profile=NAME] [--seed=N] [--size=OCTETS] [--scripts=SCRIPT:WEIGHT,...]
+ *               [--combining=P] [--emoji=P] [--invalid=P] [--output=FILE] [--list]
+ *
+ * Writes a generated corpus (see generate_corpus) to FILE or to the standard output, so
+ * that the benchmarks reading files (such as utf8proc/bench) can run without network access.
+ * The options after --profile override the parameters of the profile.
+ */
+
+namespace
+{
+
+using unicpp::bench::script;
+
+const std::size_t DEFAULT_SIZE = 1024 * 1024;
+
+script parse_script(const std::string& name)
+{
+    if(name == "ascii")
+        return script::ascii;
+    if(name == "latin1")
+        return script::latin1;
+    if(name == "greek")
+        return script::greek;
+    if(name == "cyrillic")
+        return script::cyrillic;
+    if(name == "cjk")
+        return script::cjk;
+    if(name == "hangul")
+        return script::hangul;
+
+    throw std::invalid_argument("Unknown script: " + name);
+}
+
+std::vector<unicpp::bench::script_weight> parse_scripts(const std::string& value)
+{
+    std::vector<unicpp::bench::script_weight> scripts;
+
+    std::string::size_type begin = 0;
+    while(begin <= value.size())
+    {
+        std::string::size_type end = value.find(',', begin);
+        if(end == std::string::npos)
+            end = value.size();
+
+        std::string item = value.substr(begin, end - begin);
+        std::string::size_type colon = item.find(':');
+        double weight = (colon == std::string::npos) ? 1.0 : std::stod(item.substr(colon + 1));
+        scripts.push_back({parse_script(item.substr(0, colon)), weight});
+
+        begin = end + 1;
+    }
+
+    return scripts;
+}
+
+double parse_probability(const std::string& value)
+{
+    double probability = std::stod(value);
+    if(probability < 0 || probability > 1)
+        throw std::invalid_argument("Not a probability: " + value);
+
+    return probability;
+}
+
+void print_usage()
+{
+    std::cerr << "Usage: unicpp_corpus [--profile=NAME] [--seed=N] [--size=OCTETS] [--scripts=SCRIPT:WEIGHT,...]\n"
+                 "                     [--combining=P] [--emoji=P] [--invalid=P] [--output=FILE] [--list]\n"
+                 "Scripts: ascii, latin1, greek, cyrillic, cjk, hangul\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unicpp::bench::corpus_profile profile = unicpp::bench::get_profile("mixed");
+    std::uint64_t seed = unicpp::bench::DEFAULT_SEED;
+    std::size_t size = DEFAULT_SIZE;
+    std::string output_path;
+
+    try
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            std::string::size_type equal = arg.find('=');
+            std::string key = arg.substr(0, equal);
+            std::string value = (equal == std::string::npos) ? "" : arg.substr(equal + 1);
+
+            if(key == "--list")
+            {
+                for(const std::string& name : unicpp::bench::profile_names())
+                    std::cout << name << '\n';
+                return 0;
+            }
+            else if(key == "--profile")
+                profile = unicpp::bench::get_profile(value);
+            else if(key == "--seed")
+                seed = std::stoull(value);
+            else if(key == "--size")
+                size = static_cast<std::size_t>(std::stoull(value));
+            else if(key == "--scripts")
+                profile.scripts = parse_scripts(value);
+            else if(key == "--combining")
+                profile.combining_marks = parse_probability(value);
+            else if(key == "--emoji")
+                profile.emoji_sequences = parse_probability(value);
+            else if(key == "--invalid")
+                profile.invalid_sequences = parse_probability(value);
+            else if(key == "--output")
+                output_path = value;
+            else
+                throw std::invalid_argument("Unknown option: " + arg);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        print_usage();
+        return 1;
+    }
+
+    std::string corpus = unicpp::bench::generate_corpus(profile, seed, size);
+
+    if(output_path.empty())
+    {
+        std::cout.write(corpus.data(), corpus.size());
+        return std::cout ? 0 : 1;
+    }
+
+    std::ofstream output(output_path, std::ios::binary);
+    output.write(corpus.data(), corpus.size());
+    if(!output)
+    {
+        std::cerr << "Could not write " << output_path << '\n';
+        return 1;
+    }
+
+    return 0;
+}
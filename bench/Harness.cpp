@@ -0,0 +1,157 @@
+#include "Harness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+
+#include "../Utf8Simd.hpp"
+
+namespace unicpp
+{
+namespace bench
+{
+
+namespace
+{
+
+/**
+ * Returns the pth percentile of sorted samples (nearest rank).
+ */
+double percentile(const std::vector<double>& sorted_samples, double p)
+{
+    std::size_t rank = static_cast<std::size_t>(std::ceil(p / 100.0 * sorted_samples.size()));
+    return sorted_samples[std::max<std::size_t>(rank, 1) - 1];
+}
+
+double median(const std::vector<double>& sorted_samples)
+{
+    std::size_t middle = sorted_samples.size() / 2;
+    if(sorted_samples.size() % 2 == 1)
+        return sorted_samples[middle];
+
+    return (sorted_samples[middle - 1] + sorted_samples[middle]) / 2;
+}
+
+void write_json_string(std::ostream& output, const std::string& str)
+{
+    output << '"';
+    for(char c : str)
+    {
+        if(c == '"' || c == '\\')
+            output << '\\' << c;
+        else if(static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            output << escaped;
+        }
+        else
+            output << c;
+    }
+    output << '"';
+}
+
+const char* simd_level_name(simd_level level)
+{
+    switch(level)
+    {
+    case simd_level::avx2:
+        return "avx2";
+    case simd_level::sse42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+}
+
+double result::bytes_per_second() const
+{
+    return static_cast<double>(bytes) / median_ns * 1e9;
+}
+
+double result::items_per_second() const
+{
+    return static_cast<double>(items) / median_ns * 1e9;
+}
+
+harness::harness(const options& opts) :
+    m_options(opts)
+{
+    if(m_options.repetitions == 0)
+        m_options.repetitions = 1;
+}
+
+const std::vector<result>& harness::results() const
+{
+    return m_results;
+}
+
+void harness::write_text(std::ostream& output) const
+{
+    output << std::left << std::setw(12) << "corpus" << std::setw(44) << "benchmark"
+        << std::right << std::setw(12) << "median us" << std::setw(12) << "p99 us"
+        << std::setw(12) << "MB/s" << std::setw(14) << "Mitems/s" << '\n';
+
+    output << std::fixed << std::setprecision(1);
+    for(const result& r : m_results)
+    {
+        output << std::left << std::setw(12) << r.corpus << std::setw(44) << r.name
+            << std::right << std::setw(12) << r.median_ns / 1e3 << std::setw(12) << r.p99_ns / 1e3
+            << std::setw(12) << r.bytes_per_second() / 1e6 << std::setw(14) << r.items_per_second() / 1e6 << '\n';
+    }
+    output << std::defaultfloat << std::flush;
+}
+
+void harness::write_json(std::ostream& output) const
+{
+    output << "{\n  \"context\": {\n";
+    output << "    \"simd_level\": \"" << simd_level_name(get_simd_level()) << "\",\n";
+    output << "    \"warmup\": " << m_options.warmup << ",\n";
+    output << "    \"repetitions\": " << m_options.repetitions << "\n";
+    output << "  },\n  \"benchmarks\": [";
+
+    output << std::setprecision(10);
+    for(std::size_t i = 0; i < m_results.size(); ++i)
+    {
+        const result& r = m_results[i];
+
+        output << (i == 0 ? "\n" : ",\n") << "    {\"corpus\": ";
+        write_json_string(output, r.corpus);
+        output << ", \"name\": ";
+        write_json_string(output, r.name);
+        output << ", \"bytes\": " << r.bytes << ", \"items\": " << r.items
+            << ", \"median_ns\": " << r.median_ns << ", \"p99_ns\": " << r.p99_ns
+            << ", \"min_ns\": " << r.min_ns << ", \"max_ns\": " << r.max_ns
+            << ", \"bytes_per_second\": " << r.bytes_per_second()
+            << ", \"items_per_second\": " << r.items_per_second() << "}";
+    }
+    output << "\n  ]\n}\n" << std::flush;
+}
+
+bool harness::selected(const std::string& corpus, const std::string& name) const
+{
+    return m_options.filter.empty() || (corpus + "/" + name).find(m_options.filter) != std::string::npos;
+}
+
+void harness::record(const std::string& corpus, const std::string& name, std::size_t bytes, std::size_t items, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+
+    result r;
+    r.name = name;
+    r.corpus = corpus;
+    r.bytes = bytes;
+    r.items = items;
+    r.median_ns = median(samples);
+    r.p99_ns = percentile(samples, 99);
+    r.min_ns = samples.front();
+    r.max_ns = samples.back();
+
+    m_results.push_back(r);
+}
+
+}
+}
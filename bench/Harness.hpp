@@ -0,0 +1,113 @@
+#ifndef UNICPP_BENCH_HARNESS_H
+#define UNICPP_BENCH_HARNESS_H
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * \file Contains the measurement harness of unicpp_bench: every benchmark is run a few
+ * times to warm the caches up, then timed over several repetitions, and is reported
+ * with its median and 99th percentile times.
+ */
+
+namespace unicpp
+{
+namespace bench
+{
+
+struct options
+{
+    std::size_t warmup = 2;
+    std::size_t repetitions = 21;
+
+    // Only the benchmarks whose "corpus/name" contains the filter are run
+    std::string filter;
+};
+
+struct result
+{
+    std::string name;
+    std::string corpus;
+
+    // Processed by one run, the items are codepoints, graphemes or code units depending on the benchmark
+    std::size_t bytes;
+    std::size_t items;
+
+    // Times of one run, in nanoseconds
+    double median_ns;
+    double p99_ns;
+    double min_ns;
+    double max_ns;
+
+    double bytes_per_second() const;
+    double items_per_second() const;
+};
+
+/**
+ * Keeps the compiler from optimizing away the computation of value.
+ */
+template<typename T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class harness
+{
+public:
+    explicit harness(const options& opts);
+
+    /**
+     * Times function (which returns the result of its computation, so that it is not
+     * optimized away), unless it is excluded by the filter.
+     */
+    template<typename Function>
+    void run(const std::string& corpus, const std::string& name, std::size_t bytes, std::size_t items, Function function)
+    {
+        if(!selected(corpus, name))
+            return;
+
+        for(std::size_t i = 0; i < m_options.warmup; ++i)
+            do_not_optimize(function());
+
+        std::vector<double> samples;
+        samples.reserve(m_options.repetitions);
+        for(std::size_t i = 0; i < m_options.repetitions; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            do_not_optimize(function());
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            samples.push_back(elapsed.count());
+        }
+
+        record(corpus, name, bytes, items, samples);
+    }
+
+    const std::vector<result>& results() const;
+
+    /**
+     * Writes the results as a table, one line per benchmark.
+     */
+    void write_text(std::ostream& output) const;
+
+    /**
+     * Writes the results and the context of the run as a JSON document,
+     * for the regression tracking tools.
+     */
+    void write_json(std::ostream& output) const;
+
+private:
+    bool selected(const std::string& corpus, const std::string& name) const;
+    void record(const std::string& corpus, const std::string& name, std::size_t bytes, std::size_t items, std::vector<double>& samples);
+
+    options m_options;
+    std::vector<result> m_results;
+};
+
+}
+}
+
+#endif
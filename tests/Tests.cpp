@@ -1,9 +1,26 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
+#include "../GraphemeSegmenter.hpp"
+#include "../MappedFile.hpp"
 #include "../String.hpp"
+#include "../StringView.hpp"
+#include "../Utf8Parallel.hpp"
+#include "../Utf8Simd.hpp"
+#include "../Utf8Stream.hpp"
+#include "../Utf8Transcode.hpp"
 
 TEST_CASE("Construction")
 {
@@ -20,6 +37,12 @@ TEST_CASE("Construction")
 
     unicpp::string repeated(10, U'c');
     REQUIRE(repeated.std_str() == "cccccccccc");
+
+    unicpp::string repeated_emoji(3, U'\U0001F78A');
+    REQUIRE(repeated_emoji.std_str() == u8"\U0001F78A\U0001F78A\U0001F78A");
+    REQUIRE(repeated_emoji.codepoints_count() == 3);
+    REQUIRE(unicpp::string(0, U'c').std_str().empty());
+    REQUIRE_THROWS_AS(unicpp::string(2, 0x110000), unicpp::invalid_codepoint_exception);
 }
 
 TEST_CASE("Conversion from/to UTF32")
@@ -45,6 +68,96 @@ TEST_CASE("Conversion from/to UTF16")
     // TODO: Test for surrogates
 }
 
+TEST_CASE("Conversion from/to wide strings")
+{
+    unicpp::string utf8str(L"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(utf8str.std_str() == u8"Elegant, 时尚, élégant, 🞊");
+
+    REQUIRE(utf8str.w_str() == L"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(unicpp::string(utf8str.w_str()).std_str() == u8"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(utf8str.codepoints_count() == 23);
+
+    std::string long_utf8;
+    for(int i = 0; i < 20; ++i)
+        long_utf8 += u8"abcdefgh élégant 时尚 🞊 ";
+    unicpp::string long_str(long_utf8.c_str());
+    REQUIRE(unicpp::string(long_str.w_str()).std_str() == long_utf8);
+
+    REQUIRE(unicpp::string().w_str().empty());
+    REQUIRE_THROWS_AS(unicpp::string("abc\xFF").w_str(), unicpp::invalid_utf8_exception);
+}
+
+TEST_CASE("Transcoding into buffers")
+{
+    std::string utf8(u8"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(unicpp::utf32_length_from_utf8(utf8.data(), utf8.data() + utf8.size()) == 23);
+    REQUIRE(unicpp::utf16_length_from_utf8(utf8.data(), utf8.data() + utf8.size()) == 24);
+
+    std::u32string utf32(U"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(unicpp::utf8_length_from_utf32(utf32.data(), utf32.data() + utf32.size()) == utf8.size());
+
+    std::u16string utf16(u"Elegant, 时尚, élégant, 🞊");
+    REQUIRE(unicpp::utf8_length_from_utf16(utf16.data(), utf16.data() + utf16.size()) == utf8.size());
+
+    // The buffer storage is reused
+    unicpp::string str(utf32);
+    std::u32string buffer32(100, U'x');
+    const char32_t* storage32 = buffer32.data();
+    str.utf32_into(buffer32);
+    REQUIRE(buffer32 == utf32);
+    REQUIRE(buffer32.data() == storage32);
+
+    std::u16string buffer16(100, u'x');
+    const char16_t* storage16 = buffer16.data();
+    str.utf16_into(buffer16);
+    REQUIRE(buffer16 == utf16);
+    REQUIRE(buffer16.data() == storage16);
+
+    unicpp::string broken("\xF0\x9F" "\xE2\x82\xAC" "abc\xFF");
+    REQUIRE_THROWS_AS(broken.utf16_into(buffer16), unicpp::bad_utf8_sequence_exception);
+    broken.utf16_into(buffer16, unicpp::lossy_decoding());
+    REQUIRE(buffer16 == broken.utf16_str(unicpp::lossy_decoding()));
+    broken.utf32_into(buffer32, unicpp::lossy_decoding());
+    REQUIRE(buffer32 == broken.utf32_str(unicpp::lossy_decoding()));
+}
+
+TEST_CASE("ASCII runs")
+{
+    std::string ascii("0123456789abcdefghij\xC3\xA9klm");
+    REQUIRE(unicpp::ascii_run_length(ascii.data(), ascii.data() + ascii.size()) == 20);
+    REQUIRE(unicpp::ascii_run_length(ascii.begin(), ascii.end()) == 20);
+    REQUIRE(unicpp::ascii_run_length(ascii.data() + 22, ascii.data() + ascii.size()) == 3);
+
+    std::u16string ascii16(u"0123456789abcdefghij\u00E9klm");
+    REQUIRE(unicpp::ascii_run_length(ascii16.data(), ascii16.data() + ascii16.size()) == 20);
+
+    std::u32string ascii32(U"0123456789abcdefghij\U0001F78Aklm");
+    REQUIRE(unicpp::ascii_run_length(ascii32.data(), ascii32.data() + ascii32.size()) == 20);
+
+    // Contiguous and generic ranges give the same results
+    std::string mixed(u8"Long ASCII run before élégant, 时尚, then 🞊 and more ASCII at the end");
+    std::u32string from_pointers, from_iterators;
+    unicpp::utf8_to_utf32(mixed.data(), mixed.data() + mixed.size(), std::back_inserter(from_pointers));
+    unicpp::utf8_to_utf32(mixed.begin(), mixed.end(), std::back_inserter(from_iterators));
+    REQUIRE(from_pointers == from_iterators);
+
+    std::string narrowed;
+    unicpp::utf32_to_utf8(from_pointers.data(), from_pointers.data() + from_pointers.size(), std::back_inserter(narrowed));
+    REQUIRE(narrowed == mixed);
+
+    // Single-pass input iterators
+    std::istringstream codepoints("104 105 33 233 120 121");
+    std::string from_stream;
+    unicpp::utf32_to_utf8(std::istream_iterator<unsigned>(codepoints), std::istream_iterator<unsigned>(), std::back_inserter(from_stream));
+    REQUIRE(from_stream == u8"hi!éxy");
+
+    std::istringstream octets(mixed);
+    octets >> std::noskipws;
+    std::u32string from_octets;
+    unicpp::utf8_to_utf32(std::istream_iterator<char>(octets), std::istream_iterator<char>(), std::back_inserter(from_octets));
+    REQUIRE(from_octets == from_pointers);
+}
+
 unicpp::string testing_strings[] = {
     // Valid:
     u8"Elegant, 时尚, élégant, 🞊",
@@ -88,6 +201,47 @@ TEST_CASE("Exceptions when browsing a utf8 string")
     REQUIRE_THROWS_AS(testing_strings[10].utf32_str(), unicpp::invalid_codepoint_exception);
 }
 
+unicpp::utf8_status first_decoding_error(const unicpp::string& str)
+{
+    auto it = str.std_str().begin();
+    while(true)
+    {
+        unicpp::utf8_decode_result result = unicpp::decode_next(it, str.std_str().end());
+        if(result.status != unicpp::utf8_status::ok)
+            return result.status;
+    }
+}
+
+TEST_CASE("Status codes when decoding a utf8 string")
+{
+    REQUIRE(first_decoding_error(testing_strings[0]) == unicpp::utf8_status::end_of_range);
+    REQUIRE(first_decoding_error(testing_strings[1]) == unicpp::utf8_status::invalid_octet);
+    REQUIRE(first_decoding_error(testing_strings[2]) == unicpp::utf8_status::invalid_octet);
+    REQUIRE(first_decoding_error(testing_strings[3]) == unicpp::utf8_status::bad_lead_octet);
+    REQUIRE(first_decoding_error(testing_strings[4]) == unicpp::utf8_status::bad_lead_octet);
+    REQUIRE(first_decoding_error(testing_strings[5]) == unicpp::utf8_status::truncated_sequence);
+    REQUIRE(first_decoding_error(testing_strings[6]) == unicpp::utf8_status::end_of_range);
+    REQUIRE(first_decoding_error(testing_strings[7]) == unicpp::utf8_status::bad_lead_octet);
+    REQUIRE(first_decoding_error(testing_strings[8]) == unicpp::utf8_status::truncated_sequence);
+    REQUIRE(first_decoding_error(testing_strings[9]) == unicpp::utf8_status::invalid_codepoint);
+    REQUIRE(first_decoding_error(testing_strings[10]) == unicpp::utf8_status::invalid_codepoint);
+
+    // The decoded codepoint and the length of its sequence are reported
+    std::string sequence(u8"\U0001F78A");
+    auto it = sequence.cbegin();
+    unicpp::utf8_decode_result result = unicpp::decode_next(it, sequence.cend());
+    REQUIRE(result.status == unicpp::utf8_status::ok);
+    REQUIRE(result.codepoint == 0x1F78A);
+    REQUIRE(result.length == 4);
+    REQUIRE(it == sequence.cend());
+
+    // On error, the iterator is left on the octet that was rejected
+    std::string truncated("\xEC\xACz");
+    auto it2 = truncated.cbegin();
+    REQUIRE(unicpp::decode_next(it2, truncated.cend()).status == unicpp::utf8_status::truncated_sequence);
+    REQUIRE(*it2 == 'z');
+}
+
 TEST_CASE("string::is_valid")
 {
     REQUIRE(testing_strings[0].is_valid() == true);
@@ -103,6 +257,180 @@ TEST_CASE("string::is_valid")
     REQUIRE(testing_strings[10].is_valid() == false);
 }
 
+TEST_CASE("validate_utf8")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    for(auto level : levels)
+    {
+        for(const auto& str : testing_strings)
+            REQUIRE(unicpp::validate_utf8(str.std_str().data(), str.std_str().size(), level) == str.is_valid());
+    }
+
+    // Codepoints whose lower 16 bits look like a surrogate are valid
+    REQUIRE(unicpp::string(u8"\U0002D800 \U0001DFFF").is_valid() == true);
+
+    // Random mix of valid sequences and suspicious octets, long enough to cross several blocks
+    const char* pieces[] = {
+        "a", "abcdefgh", u8"\u00E9", u8"\u65F6", u8"\U0001F78A", u8"\uFFFD", u8"\uFFEE",
+        "\xC0", "\xC1", "\xC2", "\xE0", "\xED", "\xEF", "\xF0", "\xF4", "\xF5", "\xF7", "\xFF",
+        "\x80", "\x8D", "\x8F", "\x90", "\xA0", "\xBE", "\xBF"
+    };
+    const std::size_t pieces_count = sizeof(pieces) / sizeof(pieces[0]);
+
+    std::mt19937 generator(42);
+    for(int i = 0; i < 20000; ++i)
+    {
+        std::string input;
+        std::size_t length = generator() % 200;
+        while(input.size() < length)
+        {
+            // Mostly valid content so that errors are found at any position
+            std::size_t piece = generator() % (i % 2 ? pieces_count : 7);
+            input += pieces[piece];
+        }
+
+        bool expected = unicpp::is_valid_utf8(input.begin(), input.end());
+        for(auto level : levels)
+            REQUIRE(unicpp::validate_utf8(input.data(), input.size(), level) == expected);
+    }
+}
+
+TEST_CASE("find_invalid_utf8")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    std::mt19937 generator(7);
+    for(int i = 0; i < 5000; ++i)
+    {
+        // Long valid prefix followed by a single error
+        std::string input;
+        std::size_t length = generator() % 300;
+        while(input.size() < length)
+            input += (generator() % 3 == 0) ? u8"\u65F6" : "ab";
+
+        const char* errors[] = {"\x80", "\xC0", "\xE0\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xEF\xBF\xBE"};
+        std::size_t expected = input.size();
+        if(i % 4 != 0)
+            input += errors[generator() % 6];
+        input += "tail";
+
+        for(auto level : levels)
+            REQUIRE(unicpp::find_invalid_utf8(input.data(), input.size(), level) == (i % 4 != 0 ? expected : input.size()));
+    }
+
+    // Empty input without any buffer, and a sequence cut by the end of the last full block
+    std::string cut(63, 'a');
+    cut += "\xE2";
+    for(auto level : levels)
+    {
+        REQUIRE(unicpp::find_invalid_utf8(nullptr, 0, level) == 0);
+        REQUIRE(unicpp::find_invalid_utf8(cut.data(), cut.size(), level) == 63);
+    }
+}
+
+TEST_CASE("Parallel validation and counting")
+{
+    std::string valid;
+    while(valid.size() < 3 * unicpp::PARALLEL_MIN_CHUNK_SIZE + 1000)
+        valid += u8"Le café 时尚 \U0001F468‍\U0001F469 ";
+    std::size_t codepoints = unicpp::count_utf8_codepoints(valid.data(), valid.size());
+
+    // Runs the tasks on their own threads, joined once the scan is done
+    std::vector<std::thread> pool;
+    unicpp::executor on_threads = [&pool](std::function<void()> task) { pool.emplace_back(std::move(task)); };
+    unicpp::executor inline_executor = [](std::function<void()> task) { task(); };
+
+    for(std::size_t threads = 0; threads <= 5; ++threads)
+    {
+        REQUIRE(unicpp::validate_utf8_parallel(valid.data(), valid.size(), threads));
+        REQUIRE(unicpp::count_utf8_codepoints_parallel(valid.data(), valid.size(), threads) == codepoints);
+        REQUIRE(unicpp::validate_utf8_parallel(valid.data(), valid.size(), threads, inline_executor));
+        REQUIRE(unicpp::count_utf8_codepoints_parallel(valid.data(), valid.size(), threads, on_threads) == codepoints);
+        for(std::thread& thread : pool)
+            thread.join();
+        pool.clear();
+    }
+
+    REQUIRE(unicpp::find_invalid_utf8_parallel(valid.data(), 0, 4) == 0);
+    REQUIRE(unicpp::count_utf8_codepoints_parallel("abc", 3, 4) == 3);
+
+    // Errors around the boundaries of the chunks, where the sequences are cut
+    const char* errors[] = {"\x80", "\x80\x80\x80\x80\x80", "\xC3", "\xE6\x97", "\xF0\x9F\x91", "\xED\xA0\x80", "\xF4\x90\x80\x80"};
+    std::mt19937 generator(25);
+    for(int i = 0; i < 300; ++i)
+    {
+        std::size_t threads = 2 + generator() % 4;
+        std::size_t chunk = std::max((valid.size() + threads - 1) / threads, unicpp::PARALLEL_MIN_CHUNK_SIZE);
+        std::size_t boundary = (1 + generator() % (valid.size() / chunk)) * chunk;
+        std::size_t position = std::min(boundary - 6 + generator() % 12, valid.size());
+
+        std::string input = valid.substr(0, position) + errors[generator() % 7] + valid.substr(position);
+        if(i % 5 == 0)
+            input[generator() % input.size()] = '\xFF';
+
+        std::size_t expected = unicpp::find_invalid_utf8(input.data(), input.size());
+        REQUIRE(unicpp::find_invalid_utf8_parallel(input.data(), input.size(), threads) == expected);
+        REQUIRE(unicpp::find_invalid_utf8_parallel(input.data(), input.size(), threads, inline_executor) == expected);
+        REQUIRE(!unicpp::validate_utf8_parallel(input.data(), input.size(), threads));
+    }
+}
+
+TEST_CASE("Lossy decoding")
+{
+    // Each maximal subpart of an invalid sequence is replaced by a single U+FFFD
+    REQUIRE(testing_strings[1].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uFFFD\u0011 character");
+    REQUIRE(testing_strings[2].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uFFFD\uFFFD character");
+    REQUIRE(testing_strings[5].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uFFFD character");
+    REQUIRE(testing_strings[6].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uCB2D character");
+    REQUIRE(testing_strings[7].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uCB2F\uFFFD character");
+    REQUIRE(testing_strings[8].utf32_str(unicpp::lossy_decoding()) == U"This contains an \uFFFD");
+    REQUIRE(testing_strings[9].utf32_str(unicpp::lossy_decoding()) == U"This is \uFFFD\uFFFD\uFFFD surrogate!");
+    REQUIRE(testing_strings[10].utf32_str(unicpp::lossy_decoding()) == U"This is \uFFFD\uFFFD invalid!");
+    REQUIRE(unicpp::string("\xF4\x90\x80\x80!").utf16_str(unicpp::lossy_decoding()) == u"\uFFFD\uFFFD\uFFFD\uFFFD!");
+
+    // Valid strings are decoded as usual
+    REQUIRE(testing_strings[0].utf16_str(unicpp::lossy_decoding()) == testing_strings[0].utf16_str());
+
+    // Iterating backward gives the same codepoints
+    unicpp::string broken("a\xE1\x80\xE1\x80\x80\xC3\xA9\xA9\xFFz");
+    std::u32string forward;
+    for(auto it = broken.cbegin(unicpp::lossy_decoding()); it != broken.cend(unicpp::lossy_decoding()); ++it)
+        forward.push_back(*it);
+    REQUIRE(forward == U"a\uFFFD\u1000\u00E9\uFFFD\uFFFDz");
+
+    std::u32string backward;
+    for(auto it = broken.cend(unicpp::lossy_decoding()); it != broken.cbegin(unicpp::lossy_decoding()); )
+    {
+        --it;
+        backward.insert(backward.begin(), *it);
+    }
+    REQUIRE(backward == forward);
+}
+
+TEST_CASE("string::sanitize")
+{
+    for(const auto& str : testing_strings)
+    {
+        unicpp::string sanitized = str.sanitized();
+        REQUIRE(sanitized.is_valid());
+        REQUIRE(sanitized.utf32_str() == str.utf32_str(unicpp::lossy_decoding()));
+
+        unicpp::string copy = str;
+        REQUIRE(copy.sanitize().std_str() == sanitized.std_str());
+    }
+
+    REQUIRE(testing_strings[0].sanitized().std_str() == testing_strings[0].std_str());
+}
+
 TEST_CASE("codepoint_iterator")
 {
     // Forward iterating
@@ -127,6 +455,44 @@ TEST_CASE("codepoint_iterator")
     REQUIRE(result2 == U"Elegant, 时尚, élégant, 🞊");
 }
 
+TEST_CASE("codepoint_iterator caching and trusted iteration")
+{
+    unicpp::string utf8str(u"Elegant, 时尚, élégant, 🞊");
+
+    std::u32string trusted;
+    for(auto it = utf8str.cbegin(unicpp::trusted_decoding()); it != utf8str.cend(unicpp::trusted_decoding()); ++it)
+        trusted.push_back(*it);
+    REQUIRE(trusted == U"Elegant, 时尚, élégant, 🞊");
+
+    std::u32string trusted_backward;
+    for(auto it = utf8str.cend(unicpp::trusted_decoding()); it != utf8str.cbegin(unicpp::trusted_decoding()); )
+    {
+        --it;
+        trusted_backward.insert(trusted_backward.begin(), *it);
+    }
+    REQUIRE(trusted_backward == trusted);
+
+    // The length of the sequence is known once the iterator is positioned
+    auto it = utf8str.cbegin();
+    REQUIRE(it.sequence_length() == 1);
+    std::advance(it, 9);
+    REQUIRE(*it == U'时');
+    REQUIRE(it.sequence_length() == 3);
+
+    // Errors are only reported when the invalid codepoint is reached
+    auto invalid_it = testing_strings[5].cbegin();
+    REQUIRE_NOTHROW(std::advance(invalid_it, 17));
+    REQUIRE_THROWS_AS(*invalid_it, unicpp::bad_utf8_sequence_exception);
+    REQUIRE_THROWS_AS(++invalid_it, unicpp::bad_utf8_sequence_exception);
+    REQUIRE_THROWS_AS(*testing_strings[0].cend(), unicpp::bad_utf8_sequence_exception);
+
+    // Default constructed iterators are at the end of an empty range
+    unicpp::string::const_iterator default_it;
+    unicpp::string::const_iterator default_copy(default_it);
+    REQUIRE_THROWS_AS(*default_copy, unicpp::bad_utf8_sequence_exception);
+    REQUIRE_THROWS_AS(default_copy.sequence_length(), unicpp::bad_utf8_sequence_exception);
+}
+
 TEST_CASE("grapheme_iterator")
 {
     // Forward iterating with graphemes in a string without multi codepoint graphemes
@@ -165,6 +531,519 @@ TEST_CASE("grapheme_iterator")
     REQUIRE((*git)[1] == 0x030A);
 }
 
+TEST_CASE("Grapheme break table")
+{
+    const unicpp::grapheme_break_table& table = unicpp::grapheme_break_table::get();
+
+    std::size_t wrong_classes = 0;
+    for(char32_t codepoint = 0; codepoint < 0x110000; ++codepoint)
+    {
+        if(table.get_class(codepoint) != utf8proc_get_property(codepoint)->boundclass)
+            ++wrong_classes;
+    }
+    REQUIRE(wrong_classes == 0);
+    REQUIRE(table.get_class(0x110000) == utf8proc_get_property(0x110000)->boundclass);
+
+    // Same boundaries and states as utf8proc, from every state
+    std::vector<char32_t> codepoints{U'a', U'\r', U'\n', 0x0301, 0x200D, 0x1100, 0x1161, 0x11A8, 0xAC00, 0xAC01,
+        0x1F1E6, 0x1F1EB, 0x0903, 0x0600, 0x1F466, 0x1F3FB, 0x2764, 0x1F468, 0xFE0F, 0x10FFFF};
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::uint32_t> distribution(0, 0x10FFFF);
+    for(int i = 0; i < 200; ++i)
+        codepoints.push_back(distribution(generator));
+
+    std::size_t mismatches = 0;
+    for(utf8proc_int32_t initial_state = 0; initial_state <= UTF8PROC_BOUNDCLASS_E_BASE_GAZ; ++initial_state)
+    {
+        for(char32_t previous : codepoints)
+        {
+            for(char32_t next : codepoints)
+            {
+                utf8proc_int32_t expected_state = initial_state;
+                utf8proc_int32_t state = initial_state;
+                bool expected = utf8proc_grapheme_break_stateful(previous, next, &expected_state);
+                if(table.is_break(previous, next, state) != expected || state != expected_state)
+                    ++mismatches;
+            }
+        }
+    }
+    REQUIRE(mismatches == 0);
+
+    // Emoji modifiers and ZWJ sequences stay in one grapheme
+    unicpp::string family(u8"\U0001F468\u200D\U0001F469\u200D\U0001F467 \U0001F44D\U0001F3FD\r\n");
+    REQUIRE(family.graphemes_count() == 4);
+
+    // Regional indicators, segmented as utf8proc does
+    std::u32string flags(U"a\U0001F1EB\U0001F1F7\U0001F1E9\U0001F1EA\U0001F1EE b\U0001F1EB\U0001F1F7\U0001F1E9");
+    std::size_t expected_count = 1;
+    utf8proc_int32_t state = 0;
+    for(std::size_t i = 0; i + 1 < flags.size(); ++i)
+        expected_count += utf8proc_grapheme_break_stateful(flags[i], flags[i + 1], &state) ? 1 : 0;
+    REQUIRE(unicpp::string(flags).graphemes_count() == expected_count);
+}
+
+TEST_CASE("grapheme_segmenter")
+{
+    std::string text(u8"Le cafe\u0301 时尚 \U0001F468\u200D\U0001F469\u200D\U0001F467 \U0001F44D\U0001F3FD\r\n"
+        u8"\U0001F1EB\U0001F1F7\U0001F1E9\U0001F1EA 한국어 \u1100\u1161\u11A8 e\u0323\u0302!");
+
+    std::vector<std::uint64_t> expected;
+    unicpp::string str(text.c_str());
+    for(auto it = str.gbegin(); it != str.gend(); ++it)
+        expected.push_back((*it).end_offset());
+
+    unicpp::grapheme_segmenter segmenter;
+    std::vector<std::uint64_t> boundaries;
+
+    // Whole stream
+    REQUIRE(segmenter.feed(text.data(), text.size(), boundaries) == expected.size() - 1);
+    REQUIRE(segmenter.position() == text.size());
+    REQUIRE(segmenter.finish(boundaries) == 1);
+    REQUIRE(boundaries == expected);
+    REQUIRE(segmenter.position() == 0);
+
+    // Chunks of every size, and random chunks, cutting the sequences anywhere
+    for(std::size_t chunk = 1; chunk <= 9; ++chunk)
+    {
+        boundaries.clear();
+        for(std::size_t i = 0; i < text.size(); i += chunk)
+            segmenter.feed(text.data() + i, std::min(chunk, text.size() - i), boundaries);
+        segmenter.finish(boundaries);
+        REQUIRE(boundaries == expected);
+    }
+
+    std::mt19937 generator(42);
+    for(int round = 0; round < 100; ++round)
+    {
+        boundaries.clear();
+        for(std::size_t i = 0; i < text.size(); )
+        {
+            std::size_t chunk = std::min<std::size_t>(generator() % 12, text.size() - i);
+            segmenter.feed(text.data() + i, chunk, boundaries);
+            i += chunk;
+        }
+        segmenter.finish(boundaries);
+        REQUIRE(boundaries == expected);
+    }
+
+    // Empty stream
+    boundaries.clear();
+    REQUIRE(segmenter.finish(boundaries) == 0);
+    REQUIRE(boundaries.empty());
+
+    // Errors, also when the sequence is cut between two chunks
+    REQUIRE_THROWS_AS(segmenter.feed("ab\xFF", 3, boundaries), unicpp::invalid_utf8_exception);
+    segmenter.reset();
+    REQUIRE(segmenter.feed("ab\xE2\x82", 4, boundaries) == 1);
+    REQUIRE_THROWS_AS(segmenter.feed("a", 1, boundaries), unicpp::bad_utf8_sequence_exception);
+    segmenter.reset();
+    REQUIRE(segmenter.feed("ab\xE2", 3, boundaries) == 1);
+    REQUIRE(segmenter.feed("\x82", 1, boundaries) == 0);
+    REQUIRE_THROWS_AS(segmenter.finish(boundaries), unicpp::bad_utf8_sequence_exception);
+    REQUIRE(segmenter.position() == 0);
+    REQUIRE(segmenter.feed("\xED", 1, boundaries) == 0);
+    REQUIRE_THROWS_AS(segmenter.feed("\xA0\x80", 2, boundaries), unicpp::invalid_codepoint_exception);
+
+    // Empty chunks, without any buffer, while a sequence is cut
+    segmenter.reset();
+    boundaries.clear();
+    REQUIRE(segmenter.feed("\xE2", 1, boundaries) == 0);
+    REQUIRE(segmenter.feed(nullptr, 0, boundaries) == 0);
+    REQUIRE(segmenter.feed("\x82\xAC!", 3, boundaries) == 1);
+    REQUIRE(segmenter.finish(boundaries) == 1);
+    REQUIRE((boundaries == std::vector<std::uint64_t>{3, 4}));
+}
+
+TEST_CASE("complete_cut_sequence")
+{
+    auto octets = [](const char* str) { return reinterpret_cast<const unsigned char*>(str); };
+    unsigned char pending[4] = {0xF0};
+    std::size_t pending_length = 1;
+
+    // Chunks too short to end the sequence are kept
+    unicpp::utf8_cut_sequence_result cut = unicpp::complete_cut_sequence(pending, pending_length, octets("\x9F"), 1);
+    REQUIRE(cut.incomplete);
+    REQUIRE(cut.chunk_octets == 1);
+    REQUIRE(pending_length == 2);
+
+    cut = unicpp::complete_cut_sequence(pending, pending_length, octets("\x98\x80" "ab"), 4);
+    REQUIRE(!cut.incomplete);
+    REQUIRE(cut.decoded.status == unicpp::utf8_status::ok);
+    REQUIRE(cut.decoded.codepoint == U'\U0001F600');
+    REQUIRE(cut.chunk_octets == 2);
+    REQUIRE(pending_length == 2);
+
+    // Errors are reported with the octets of the chunk read before them
+    cut = unicpp::complete_cut_sequence(pending, pending_length, octets("\x98" "a"), 2);
+    REQUIRE(!cut.incomplete);
+    REQUIRE(cut.decoded.status == unicpp::utf8_status::truncated_sequence);
+    REQUIRE(cut.chunk_octets == 1);
+    REQUIRE(pending_length == 2);
+}
+
+TEST_CASE("utf8_stream_decoder")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    // Decodes input in chunks of the given sizes (repeated), returns the codepoints before the first error
+    auto decode_chunks = [](unicpp::utf8_stream_decoder& decoder, const std::string& input, const std::vector<std::size_t>& chunks)
+    {
+        std::u32string output(input.size() + 1, U'\0');
+        char32_t* output_end = &output[0];
+        std::size_t i = 0;
+        for(std::size_t c = 0; i < input.size(); ++c)
+        {
+            std::size_t chunk = std::min(chunks[c % chunks.size()], input.size() - i);
+            output_end = decoder.decode(input.data() + i, chunk, output_end);
+            i += chunk;
+        }
+        decoder.finish();
+        output.resize(output_end - output.data());
+        return output;
+    };
+
+    const char* pieces[] = {"ab", "abcdefghijklmnopqrstuvwxyz", u8"é", u8"时", u8"\U0001F468", u8"‍"};
+    const char* errors[] = {"\x80", "\xC0", "\xE0\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xEF\xBF\xBE", "\xF0\x9F\x98"};
+
+    std::mt19937 generator(21);
+    for(int round = 0; round < 300; ++round)
+    {
+        std::string input;
+        std::size_t length = generator() % (round % 10 ? 100 : 2000);
+        while(input.size() < length)
+            input += pieces[generator() % 6];
+        std::size_t error = generator() % 7;
+        if(round % 3 != 0)
+            input += errors[error];
+        if(round % 2 != 0)
+            input += u8"tail时";
+        bool truncated = round % 3 != 0 && round % 2 == 0 && error == 6;
+
+        // The reference is the same input in a single buffer
+        std::size_t error_offset = unicpp::find_invalid_utf8(input.data(), input.size(), unicpp::simd_level::scalar);
+        std::u32string expected;
+        unicpp::utf8_to_utf32(input.begin(), input.begin() + error_offset, std::back_inserter(expected));
+
+        std::vector<std::vector<std::size_t>> chunkings{{input.size() + 1}, {1}, {2}, {3}, {5}, {7}, {64}, {1, 30, 2}};
+        std::vector<std::size_t> random_chunks;
+        for(int i = 0; i < 20; ++i)
+            random_chunks.push_back(generator() % 40);
+        chunkings.push_back(random_chunks);
+
+        for(auto level : levels)
+        {
+            unicpp::utf8_stream_decoder decoder(level);
+            for(const auto& chunks : chunkings)
+            {
+                decoder.reset();
+                REQUIRE(decode_chunks(decoder, input, chunks) == expected);
+                REQUIRE(decoder.position() == input.size());
+                REQUIRE((decoder.status() == unicpp::utf8_status::ok) == (error_offset == input.size()));
+                if(decoder.status() != unicpp::utf8_status::ok)
+                    REQUIRE(decoder.error_offset() == error_offset);
+                if(truncated)
+                    REQUIRE(decoder.status() == unicpp::utf8_status::truncated_sequence);
+
+                decoder.reset();
+                bool valid = true;
+                for(std::size_t i = 0, c = 0; i < input.size(); ++c)
+                {
+                    std::size_t chunk = std::min(chunks[c % chunks.size()], input.size() - i);
+                    valid = decoder.validate(input.data() + i, chunk);
+                    i += chunk;
+                }
+                valid = decoder.finish() && valid;
+                REQUIRE(valid == (error_offset == input.size()));
+                if(!valid)
+                    REQUIRE(decoder.error_offset() == error_offset);
+            }
+        }
+    }
+
+    // The first error is kept until reset
+    unicpp::utf8_stream_decoder decoder;
+    REQUIRE(decoder.validate("ab\xE2\x82", 4));
+    REQUIRE(!decoder.validate("a\xFF", 2));
+    REQUIRE(decoder.status() == unicpp::utf8_status::truncated_sequence);
+    REQUIRE(decoder.error_offset() == 2);
+    REQUIRE(!decoder.validate("abc", 3));
+    REQUIRE(!decoder.finish());
+    REQUIRE(decoder.position() == 9);
+    decoder.reset();
+    REQUIRE(decoder.validate("\xF0", 1));
+    REQUIRE(decoder.validate("", 0));
+    REQUIRE(decoder.validate(nullptr, 0));
+    REQUIRE(decoder.validate("\x9F\x98", 2));
+    REQUIRE(decoder.validate("\x80", 1));
+    REQUIRE(decoder.finish());
+    REQUIRE(decoder.status() == unicpp::utf8_status::ok);
+
+    char32_t output[2];
+    decoder.reset();
+    REQUIRE(decoder.decode("\xE2", 1, output) == output);
+    REQUIRE(decoder.decode(nullptr, 0, output) == output);
+    REQUIRE(decoder.decode("\x82\xAC", 2, output) == output + 1);
+    REQUIRE(output[0] == U'\u20AC');
+    REQUIRE(decoder.finish());
+}
+
+TEST_CASE("string_view")
+{
+    std::string text(u8"Le café 时尚 \U0001F468‍\U0001F469‍\U0001F467 \U0001F1EB\U0001F1F7 ệ!");
+    unicpp::string str(text.c_str());
+    unicpp::string_view view(text.data(), text.size());
+
+    REQUIRE(view.octets_begin() == text.data());
+    REQUIRE(view.octets_count() == text.size());
+    REQUIRE(!view.empty());
+    REQUIRE(view.is_valid());
+
+    REQUIRE(view.codepoints_count() == str.codepoints_count());
+    REQUIRE(view.graphemes_count() == str.graphemes_count());
+    REQUIRE(view.size() == str.size());
+    REQUIRE(view.size<unicpp::as_graphemes>() == str.size<unicpp::as_graphemes>());
+
+    REQUIRE(view.utf16_str() == str.utf16_str());
+    REQUIRE(view.utf32_str() == str.utf32_str());
+    REQUIRE(view.w_str() == str.w_str());
+
+    REQUIRE(std::u32string(view.begin(), view.end()) == str.utf32_str());
+    REQUIRE(std::u32string(view.cbegin(unicpp::trusted_decoding()), view.cend(unicpp::trusted_decoding())) == str.utf32_str());
+
+    std::u32string reversed;
+    for(auto it = view.crend(); it != view.crbegin(); ++it)
+        reversed.push_back(*it);
+    REQUIRE(std::u32string(reversed.rbegin(), reversed.rend()) == str.utf32_str());
+
+    auto g = str.gbegin();
+    for(auto it = view.gbegin(); it != view.gend(); ++it, ++g)
+    {
+        REQUIRE((*it).begin_offset() == (*g).begin_offset());
+        REQUIRE((*it).end_offset() == (*g).end_offset());
+        REQUIRE((*it).octets_begin() == text.data() + (*g).begin_offset());
+    }
+    REQUIRE(g == str.gend());
+
+    // The iterators only refer to the buffer
+    unicpp::string_view::const_iterator it;
+    {
+        unicpp::string_view temporary(text.data(), text.size());
+        it = temporary.cbegin();
+    }
+    REQUIRE(*++it == U'e');
+
+    unicpp::string_view empty;
+    REQUIRE(empty.empty());
+    REQUIRE(empty.is_valid());
+    REQUIRE(empty.size() == 0);
+    REQUIRE(empty.size<unicpp::as_graphemes>() == 0);
+    REQUIRE(empty.utf32_str().empty());
+    REQUIRE(empty.begin() == empty.end());
+
+    // Invalid buffers
+    std::string invalid("ab\xE2\x82z");
+    unicpp::string_view invalid_view(invalid.data(), invalid.size());
+    REQUIRE(!invalid_view.is_valid());
+    REQUIRE_THROWS_AS(invalid_view.codepoints_count(), unicpp::bad_utf8_sequence_exception);
+    REQUIRE_THROWS_AS(invalid_view.utf32_str(), unicpp::bad_utf8_sequence_exception);
+    REQUIRE(invalid_view.utf32_str(unicpp::lossy_decoding()) == U"ab�z");
+    REQUIRE(invalid_view.utf16_str(unicpp::lossy_decoding()) == u"ab�z");
+    REQUIRE(std::u32string(invalid_view.cbegin(unicpp::lossy_decoding()), invalid_view.cend(unicpp::lossy_decoding())) == U"ab�z");
+}
+
+TEST_CASE("string_view random access and slices")
+{
+    unicpp::string str(u8"Le café 时尚 \U0001F468‍\U0001F469‍\U0001F467 \U0001F1EB\U0001F1F7 ệ!");
+    unicpp::string_view view = str;
+    REQUIRE(view.octets_begin() == str.std_str().data());
+    REQUIRE(unicpp::string_view("abc").octets_count() == 3);
+    REQUIRE(unicpp::string(view).std_str() == str.std_str());
+
+    std::size_t codepoints = str.codepoints_count();
+    for(std::size_t n = 0; n <= codepoints; ++n)
+    {
+        REQUIRE(view.codepoint_offset(n) == str.codepoint_offset(n));
+        REQUIRE(view.codepoint_index(str.codepoint_offset(n)) == n);
+        if(n < codepoints)
+        {
+            REQUIRE(view.at(n) == str.at(n));
+            REQUIRE(*view.nth(n) == str.at(n));
+        }
+
+        for(std::size_t count : {std::size_t(0), std::size_t(1), std::size_t(3), unicpp::string_view::npos})
+        {
+            unicpp::string_view slice = view.substr(n, count);
+            REQUIRE(slice.octets_begin() == view.octets_begin() + view.codepoint_offset(n));
+            REQUIRE(unicpp::string(slice).std_str() == str.substr(n, count).std_str());
+        }
+    }
+    REQUIRE_THROWS_AS(view.at(codepoints), std::out_of_range);
+    REQUIRE_THROWS_AS(view.codepoint_offset(codepoints + 1), std::out_of_range);
+    REQUIRE_THROWS_AS(view.substr(codepoints + 1), std::out_of_range);
+
+    std::size_t graphemes = str.graphemes_count();
+    for(std::size_t n = 0; n <= graphemes; ++n)
+    {
+        auto expected = str.nth_grapheme(n);
+        auto it = view.nth_grapheme(n);
+        REQUIRE(it.codepoint_it.internal_it - view.octets_begin() == expected.codepoint_it.internal_it - str.std_str().begin());
+        if(n < graphemes)
+        {
+            std::size_t offset = (*it).begin_offset();
+            REQUIRE(view.grapheme_index(offset) == str.grapheme_index(offset));
+            REQUIRE(view.grapheme_index(offset + 1) == str.grapheme_index(offset + 1));
+
+            unicpp::string_view octets = view.octets_substr(offset, (*it).octets_count());
+            REQUIRE(octets.graphemes_count() == 1);
+        }
+    }
+    REQUIRE_THROWS_AS(view.nth_grapheme(graphemes + 1), std::out_of_range);
+    REQUIRE(view.octets_substr(view.octets_count()).empty());
+    REQUIRE_THROWS_AS(view.octets_substr(view.octets_count() + 1), std::out_of_range);
+
+    // Only the codepoints up to the slice are validated
+    std::string invalid("ab\xFF" "cd");
+    unicpp::string_view invalid_view(invalid);
+    REQUIRE(unicpp::string(invalid_view.substr(0, 2)).std_str() == "ab");
+    REQUIRE_THROWS_AS(invalid_view.substr(0, 3), unicpp::invalid_utf8_exception);
+    REQUIRE_THROWS_AS(invalid_view.at(2), unicpp::invalid_utf8_exception);
+
+    // Units
+    auto it = unicpp::as_codepoints::cbegin(view);
+    REQUIRE(unicpp::as_codepoints::advance_safe(view, it, 3));
+    REQUIRE(*it == U'c');
+    REQUIRE(unicpp::as_codepoints::get_byte_distance(view, unicpp::as_codepoints::cbegin(view), it) == 3);
+    REQUIRE(!unicpp::as_codepoints::advance_safe(view, it, codepoints));
+    REQUIRE(it == unicpp::as_codepoints::cend(view));
+
+    auto git = unicpp::as_graphemes::cbegin(view);
+    REQUIRE(unicpp::as_graphemes::advance_safe(view, git, 11));
+    REQUIRE((*git).codepoints_count() == 5);
+    REQUIRE(unicpp::as_graphemes::get_codepoint_distance(view, unicpp::as_graphemes::cbegin(view), git) == 11);
+    REQUIRE(!unicpp::as_graphemes::advance_safe(view, git, graphemes));
+}
+
+TEST_CASE("mapped_file")
+{
+    const char* path = "unicpp_mapped_file_test.txt";
+    std::string text;
+    while(text.size() < 100000)
+        text += u8"Le café 时尚 \U0001F468‍\U0001F469\n";
+
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(text.data(), text.size());
+    }
+
+    {
+        unicpp::mapped_file file(path);
+        REQUIRE(file.size() == text.size());
+        REQUIRE(std::string(file.data(), file.size()) == text);
+
+        unicpp::string str(text.data(), text.size());
+        unicpp::string_view view = file.view();
+        REQUIRE(view.is_valid());
+        REQUIRE(view.codepoints_count() == str.codepoints_count());
+        REQUIRE(view.graphemes_count() == str.graphemes_count());
+        REQUIRE(view.utf16_str() == str.utf16_str());
+
+        file.advise(unicpp::mapped_file::access_pattern::random);
+        REQUIRE(*view.begin() == U'L');
+
+        unicpp::mapped_file moved(std::move(file));
+        REQUIRE(file.size() == 0);
+        REQUIRE(moved.data() == view.octets_begin());
+
+        moved.close();
+        REQUIRE(moved.size() == 0);
+        REQUIRE(moved.view().empty());
+    }
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    }
+    unicpp::mapped_file empty(path);
+    REQUIRE(empty.size() == 0);
+    REQUIRE(empty.view().is_valid());
+    REQUIRE(empty.view().size() == 0);
+
+    std::remove(path);
+    REQUIRE_THROWS_AS(unicpp::mapped_file(std::string(path)), std::system_error);
+}
+
+TEST_CASE("grapheme_view")
+{
+    unicpp::string str("1\145\314\201;\101\314\212");
+
+    auto git = str.gbegin();
+    ++git;
+    unicpp::grapheme_view view = *git;
+    REQUIRE(view.begin_offset() == 1);
+    REQUIRE(view.end_offset() == 4);
+    REQUIRE(view.octets_count() == 3);
+    REQUIRE(std::string(view.octets_begin(), view.octets_end()) == "\145\314\201");
+    REQUIRE(view.codepoints_count() == 2);
+    REQUIRE(view[1] == 0x0301);
+
+    unicpp::grapheme standalone = view;
+    REQUIRE(standalone.codepoints_count() == 2);
+    REQUIRE(standalone[0] == U'e');
+
+    // Iterators can be assigned
+    auto other = str.gbegin();
+    other = git;
+    REQUIRE(other == git);
+    REQUIRE((*++other)[0] == U';');
+
+    // A whole emoji ZWJ sequence is a single grapheme
+    unicpp::string family(u8"a\U0001F468\u200D\U0001F469\u200D\U0001F467b");
+    REQUIRE(std::distance(family.gbegin(), family.gend()) == 3);
+    REQUIRE((*++family.gbegin()).codepoints_count() == 5);
+}
+
+// std::vector moves the graphemes when it grows, instead of copying them
+static_assert(std::is_nothrow_move_constructible<unicpp::grapheme>::value, "grapheme moves do not throw");
+static_assert(std::is_nothrow_move_assignable<unicpp::grapheme>::value, "grapheme moves do not throw");
+
+TEST_CASE("grapheme storage")
+{
+    // Short graphemes are stored inline, long ones on the heap
+    std::u32string zalgo(U"Z\u0351\u0307\u0313\u0304\u0346\u0310\u0310\u035B\u0357");
+    std::u32string short_one(U"e\u0301");
+
+    for(const auto& codepoints : {short_one, zalgo})
+    {
+        unicpp::grapheme g(codepoints);
+        REQUIRE(std::u32string(g.codepoints_begin(), g.codepoints_end()) == codepoints);
+
+        unicpp::grapheme copy(g);
+        REQUIRE(std::u32string(copy.codepoints_begin(), copy.codepoints_end()) == codepoints);
+
+        unicpp::grapheme moved(std::move(copy));
+        REQUIRE(std::u32string(moved.codepoints_begin(), moved.codepoints_end()) == codepoints);
+        REQUIRE(copy.codepoints_count() == 0);
+
+        unicpp::grapheme assigned(U"a");
+        assigned = g;
+        REQUIRE(assigned.codepoints_count() == codepoints.size());
+        assigned = unicpp::grapheme(U"b");
+        REQUIRE(assigned.codepoints_count() == 1);
+        REQUIRE(assigned[0] == U'b');
+        assigned = std::move(moved);
+        REQUIRE(std::u32string(assigned.codepoints_begin(), assigned.codepoints_end()) == codepoints);
+    }
+
+    unicpp::string zalgo_str(zalgo + U"!");
+    unicpp::grapheme first = *zalgo_str.gbegin();
+    REQUIRE(first.codepoints_count() == zalgo.size());
+    REQUIRE(first.get_casefold()[0] == U'z');
+    REQUIRE(first.get_compat().codepoints_count() == zalgo.size());
+}
+
 TEST_CASE("string::size")
 {
     unicpp::string utf8str(u8"Elegant, 时尚, élégant, 🞊");
@@ -174,3 +1053,579 @@ TEST_CASE("string::size")
     REQUIRE(graphemeStr.size() == 3);
     REQUIRE(graphemeStr.size<unicpp::as_graphemes>() == 2);
 }
+
+TEST_CASE("count_utf8_codepoints")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    const char* pieces[] = {"a", "abcdefgh", u8"é", u8"时", u8"\U0001F78A"};
+
+    std::mt19937 generator(3);
+    for(int i = 0; i < 2000; ++i)
+    {
+        // Long enough for the 8-bit counters of the vectorized versions to be flushed
+        std::string input;
+        std::size_t length = generator() % (i % 10 ? 300 : 20000);
+        std::size_t codepoints = 0;
+        while(input.size() < length)
+        {
+            std::size_t piece = generator() % 5;
+            input += pieces[piece];
+            codepoints += (piece == 1) ? 8 : 1;
+        }
+
+        for(auto level : levels)
+            REQUIRE(unicpp::count_utf8_codepoints(input.data(), input.size(), level) == codepoints);
+    }
+}
+
+TEST_CASE("string cached counts")
+{
+    unicpp::string str(u8"é 时尚");
+    REQUIRE(str.codepoints_count() == 5);
+    REQUIRE(str.graphemes_count() == 4);
+    REQUIRE(str.size() == 5);
+    REQUIRE(str.size<unicpp::as_graphemes>() == 4);
+
+    // Copies keep the counts, moved-from strings do not
+    unicpp::string copy(str);
+    REQUIRE(copy.size() == 5);
+    unicpp::string moved(std::move(copy));
+    REQUIRE(moved.size<unicpp::as_graphemes>() == 4);
+    copy = unicpp::string("ab");
+    REQUIRE(copy.size() == 2);
+    copy = moved;
+    REQUIRE(copy.size<unicpp::as_graphemes>() == 4);
+
+    // Modifications invalidate the counts
+    str.modify([](std::string& content) { content += u8"́x"; });
+    REQUIRE(str.codepoints_count() == 7);
+    REQUIRE(str.graphemes_count() == 5);
+
+    // Even when the counts are computed again before the write, or when the write throws
+    str.build_codepoint_index();
+    str.modify([&str](std::string& content) {
+        REQUIRE(str.at(6) == U'x');
+        content = "abc";
+    });
+    REQUIRE_FALSE(str.has_codepoint_index());
+    REQUIRE(str.codepoints_count() == 3);
+    REQUIRE_THROWS_AS(str.at(6), std::out_of_range);
+    REQUIRE_THROWS_AS(str.modify([](std::string& content) {
+        content += "de";
+        throw std::runtime_error("interrupted modification");
+    }), std::runtime_error);
+    REQUIRE(str.codepoints_count() == 5);
+
+    unicpp::string invalid("ab\xFF" "cd");
+    REQUIRE_THROWS_AS(invalid.size(), unicpp::invalid_utf8_exception);
+    REQUIRE_THROWS_AS(invalid.size(), unicpp::invalid_utf8_exception);
+    REQUIRE(invalid.sanitized().size() == 5);
+    invalid.sanitize();
+    REQUIRE(invalid.size() == 5);
+
+    REQUIRE(unicpp::string().size() == 0);
+    REQUIRE(unicpp::string(3, U'时').size() == 3);
+    REQUIRE(unicpp::string(std::u32string(U"abc")).size<unicpp::as_graphemes>() == 3);
+}
+
+TEST_CASE("index_utf8_codepoints")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    const char* pieces[] = {"a", "abcdefgh", u8"é", u8"时", u8"\U0001F78A"};
+
+    std::mt19937 generator(11);
+    for(int i = 0; i < 1000; ++i)
+    {
+        std::string input;
+        std::vector<std::size_t> offsets;
+        std::size_t length = generator() % 1000;
+        while(input.size() < length)
+        {
+            std::size_t piece = generator() % 5;
+            for(const char* it = pieces[piece]; *it; ++it)
+            {
+                if((*it & 0xC0) != 0x80)
+                    offsets.push_back(input.size() + (it - pieces[piece]));
+            }
+            input += pieces[piece];
+        }
+
+        std::size_t first = generator() % 10;
+        std::size_t stride = 1 + generator() % 100;
+        std::vector<std::size_t> expected;
+        for(std::size_t n = first; n < offsets.size(); n += stride)
+            expected.push_back(offsets[n]);
+
+        for(auto level : levels)
+        {
+            std::vector<std::size_t> index{42};
+            REQUIRE(unicpp::index_utf8_codepoints(input.data(), input.size(), first, stride, index, level) == offsets.size());
+            REQUIRE(index.front() == 42);
+            REQUIRE(std::vector<std::size_t>(index.begin() + 1, index.end()) == expected);
+        }
+    }
+}
+
+TEST_CASE("Random access to codepoints")
+{
+    std::string data;
+    for(int i = 0; i < 100; ++i)
+        data += u8"Elegant, 时尚, élégant, 🞊";
+    unicpp::string str(data.data(), data.size());
+    std::u32string expected = str.utf32_str();
+
+    for(int indexed = 0; indexed < 2; ++indexed)
+    {
+        if(indexed)
+            str.build_codepoint_index();
+        REQUIRE(str.has_codepoint_index() == (indexed == 1));
+
+        for(std::size_t n = 0; n < expected.size(); n += 7)
+        {
+            REQUIRE(str.at(n) == expected[n]);
+            REQUIRE(*str.nth(n) == expected[n]);
+            REQUIRE(str.codepoint_index(str.codepoint_offset(n)) == n);
+        }
+        REQUIRE(str.codepoint_offset(expected.size()) == data.size());
+        REQUIRE_THROWS_AS(str.at(expected.size()), std::out_of_range);
+        REQUIRE_THROWS_AS(str.nth(expected.size() + 1), std::out_of_range);
+
+        REQUIRE(str.substr(300, 50).utf32_str() == expected.substr(300, 50));
+        REQUIRE(str.substr(300, 50).size() == 50);
+        REQUIRE(str.substr(2290).utf32_str() == expected.substr(2290));
+        REQUIRE(str.substr(expected.size()).size() == 0);
+        REQUIRE_THROWS_AS(str.substr(expected.size() + 1), std::out_of_range);
+
+        auto it = str.cbegin();
+        REQUIRE(unicpp::as_codepoints::advance_safe(str, it, 1000) == true);
+        REQUIRE(*it == expected[1000]);
+        REQUIRE(unicpp::as_codepoints::advance_safe(str, it, 300) == true);
+        REQUIRE(*it == expected[1300]);
+        REQUIRE(unicpp::as_codepoints::advance_safe(str, it, 10000) == false);
+        REQUIRE(it == str.cend());
+    }
+
+    // The index is patched when appending and dropped by other modifications
+    str.append(unicpp::string(u8"时尚"));
+    REQUIRE(str.has_codepoint_index());
+    str.append(str);
+    REQUIRE(str.has_codepoint_index());
+    expected += U"时尚";
+    expected += expected;
+    REQUIRE(str.size() == expected.size());
+    for(std::size_t n = 0; n < expected.size(); n += 3)
+        REQUIRE(str.at(n) == expected[n]);
+
+    str.append(unicpp::string("\xFF"));
+    REQUIRE_FALSE(str.has_codepoint_index());
+    REQUIRE_THROWS_AS(str.at(0), unicpp::invalid_utf8_exception);
+    REQUIRE_THROWS_AS(str.build_codepoint_index(), unicpp::invalid_utf8_exception);
+    str.sanitize();
+    str.build_codepoint_index();
+    str.modify([](std::string&) {});
+    REQUIRE_FALSE(str.has_codepoint_index());
+}
+
+TEST_CASE("Random access to graphemes")
+{
+    // Combining marks, emoji sequences and regional indicators (whose segmentation depends on the state)
+    const char* pieces[] = {
+        "a", "e\xCC\x81", u8"\U0001F468‍\U0001F469‍\U0001F467", u8"\U0001F44D\U0001F3FD",
+        u8"\U0001F1EB", u8"\U0001F1F7", "\r\n", u8"时", "\xCC\x81"
+    };
+
+    auto grapheme_offsets = [](const unicpp::string& str) {
+        std::vector<std::size_t> offsets;
+        auto end = str.gend();
+        for(auto it = str.gbegin(); it != end; ++it)
+            offsets.push_back(std::distance(str.std_str().begin(), it.codepoint_it.internal_it));
+        return offsets;
+    };
+
+    auto require_same_segmentation = [&](const unicpp::string& str) {
+        unicpp::string reference(str.std_str().data(), str.std_str().size());
+        std::vector<std::size_t> expected = grapheme_offsets(reference);
+        REQUIRE(str.graphemes_count() == expected.size());
+        for(std::size_t n = 0; n < expected.size(); ++n)
+        {
+            REQUIRE(std::distance(str.std_str().begin(), str.nth_grapheme(n).codepoint_it.internal_it) == expected[n]);
+            REQUIRE(str.grapheme_index(expected[n]) == n);
+        }
+        REQUIRE(str.nth_grapheme(expected.size()) == str.gend());
+    };
+
+    std::mt19937 generator(5);
+    auto random_string = [&](std::size_t pieces_count) {
+        std::string data;
+        for(std::size_t i = 0; i < pieces_count; ++i)
+            data += pieces[generator() % 9];
+        return unicpp::string(data.data(), data.size());
+    };
+
+    for(int i = 0; i < 30; ++i)
+    {
+        unicpp::string str = random_string(generator() % 800);
+        str.build_grapheme_index();
+        REQUIRE(str.has_grapheme_index());
+        require_same_segmentation(str);
+
+        // Local edits only segment again the modified region
+        for(int edit = 0; edit < 10; ++edit)
+        {
+            std::size_t pos = generator() % (str.size() + 1);
+            std::size_t count = generator() % 5;
+            if(edit % 3 == 0)
+                str.append(random_string(generator() % 4));
+            else
+                str.replace(pos, count, random_string(generator() % 4));
+
+            REQUIRE(str.has_grapheme_index());
+            require_same_segmentation(str);
+        }
+
+        auto it = str.gbegin();
+        std::size_t count = str.graphemes_count();
+        REQUIRE(unicpp::as_graphemes::advance_safe(str, it, count / 2) == true);
+        REQUIRE(it == str.nth_grapheme(count / 2));
+        REQUIRE(unicpp::as_graphemes::advance_safe(str, it, count) == (count == 0));
+        REQUIRE(it == str.gend());
+    }
+
+    unicpp::string str(u8"时尚");
+    str.build_codepoint_index();
+    str.replace(1, 1, unicpp::string(u8"é!"));
+    REQUIRE(str.has_codepoint_index());
+    REQUIRE(str.utf32_str() == U"时é!");
+    REQUIRE(str.at(3) == U'!');
+    REQUIRE_THROWS_AS(str.replace(5, 1, unicpp::string("a")), std::out_of_range);
+    REQUIRE_THROWS_AS(str.replace(0, 1, unicpp::string("\xFF")), unicpp::invalid_utf8_exception);
+    REQUIRE(str.utf32_str() == U"时é!");
+    str.modify([](std::string&) {});
+    REQUIRE_FALSE(str.has_grapheme_index());
+}
+
+TEST_CASE("DFA decoder")
+{
+    // Sequence based decoding, as done before the DFA
+    auto reference_decode_next = [](const char*& it, const char* end) {
+        unsigned char buffer[4];
+        unicpp::utf8_decode_result result = unicpp::decode_next_sequence(it, end, buffer);
+        if(result.status != unicpp::utf8_status::ok)
+            return result;
+
+        const unsigned char masks[] = {0, 0x7F, 0x1F, 0x0F, 0x07};
+        char32_t codepoint = buffer[0] & masks[result.length];
+        for(std::size_t i = 1; i < result.length; ++i)
+            codepoint = (codepoint << 6) | (buffer[i] & 0x3F);
+
+        result.codepoint = codepoint;
+        if(!unicpp::is_valid_codepoint(codepoint))
+            result.status = unicpp::utf8_status::invalid_codepoint;
+
+        return result;
+    };
+
+    auto same_decoding = [&](const std::string& input) {
+        const char* end = input.data() + input.size();
+        for(const char* begin = input.data(); begin != end; ++begin)
+        {
+            const char* it = begin;
+            const char* reference_it = begin;
+            unicpp::utf8_decode_result result = unicpp::decode_next(it, end);
+            unicpp::utf8_decode_result expected = reference_decode_next(reference_it, end);
+
+            bool has_codepoint = (result.status == unicpp::utf8_status::ok || result.status == unicpp::utf8_status::invalid_codepoint);
+            if(result.status != expected.status || result.length != expected.length || it != reference_it ||
+               (has_codepoint && result.codepoint != expected.codepoint))
+                return false;
+        }
+
+        return true;
+    };
+
+    // Every pair of octets, then longer sequences made of the octets that matter to the DFA
+    for(int lead = 0x80; lead <= 0xFF; ++lead)
+    {
+        for(int second = 0; second <= 0xFF; ++second)
+        {
+            const char sequence[] = {static_cast<char>(lead), static_cast<char>(second)};
+            REQUIRE(same_decoding(std::string(sequence, 2)));
+        }
+    }
+
+    const unsigned char interesting[] = {0x41, 0x80, 0x8D, 0x8F, 0x90, 0x9F, 0xA0, 0xBE, 0xBF, 0xC0};
+    for(int lead = 0x80; lead <= 0xFF; ++lead)
+    {
+        for(unsigned char second : interesting)
+        {
+            for(unsigned char third : interesting)
+            {
+                for(unsigned char fourth : interesting)
+                {
+                    const char sequence[] = {
+                        static_cast<char>(lead), static_cast<char>(second),
+                        static_cast<char>(third), static_cast<char>(fourth)
+                    };
+                    REQUIRE(same_decoding(std::string(sequence, 3)));
+                    REQUIRE(same_decoding(std::string(sequence, 4)));
+                }
+            }
+        }
+    }
+
+    for(const auto& str : testing_strings)
+        REQUIRE(same_decoding(str.std_str()));
+}
+
+namespace
+{
+
+/**
+ * Runs a conversion, returning its output or the type and message of the exception it threw.
+ */
+template<typename Conversion>
+std::string conversion_outcome(Conversion conversion)
+{
+    try
+    {
+        return "ok: " + conversion();
+    }
+    catch(const std::exception& e)
+    {
+        return std::string(typeid(e).name()) + ": " + e.what();
+    }
+}
+
+template<typename CodeUnit>
+std::string as_bytes(const CodeUnit* begin, const CodeUnit* end)
+{
+    return std::string(reinterpret_cast<const char*>(begin), reinterpret_cast<const char*>(end));
+}
+
+}
+
+TEST_CASE("Vectorized UTF-16 transcoding")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    // Including the accepted overlong forms and the codepoints around the surrogates
+    const char* utf8_pieces[] = {
+        "a", "abcdefghijklmnop", u8"é", u8"ß", u8"߿", u8"ࠀ", u8"时", u8"퟿", u8"", u8"�",
+        u8"\U00010000", u8"\U0001F78A", u8"\U0010FFFF", "\xE0\x80\x80", "\xE0\x81\xBF", "\xF0\x80\x81\x81", "\xF0\x8F\xBF\xBD"
+    };
+    const char* utf8_errors[] = {"\xFF", "\x80", "\xC0\x80", "\xED\xA0\x80", "\xEF\xBF\xBE", "\xE2\x82", "\xF4\x90\x80\x80"};
+
+    const char16_t* utf16_pieces[] = {
+        u"a", u"abcdefghijklmnop", u"é", u"߿", u"ࠀ", u"时", u"퟿", u"", u"�", u"\U0001F78A", u"\U0010FFFF"
+    };
+    const char16_t utf16_errors[][2] = {{0xD800, u'a'}, {0xDC00, 0}, {0xFFFE, 0}, {0xFFFF, 0}, {0xDBFF, 0xDBFF}};
+
+    std::mt19937 generator(11);
+    for(int i = 0; i < 3000; ++i)
+    {
+        std::size_t length = generator() % (i % 10 ? 200 : 5000);
+        bool with_error = (i % 3 == 0);
+
+        std::string utf8;
+        std::u16string utf16;
+        while(utf8.size() < length)
+            utf8 += utf8_pieces[generator() % (sizeof(utf8_pieces) / sizeof(utf8_pieces[0]))];
+        while(utf16.size() < length)
+            utf16 += utf16_pieces[generator() % (sizeof(utf16_pieces) / sizeof(utf16_pieces[0]))];
+
+        if(with_error)
+        {
+            std::size_t position = generator() % (utf8.size() + 1);
+            while(position < utf8.size() && unicpp::is_trail_octet(utf8[position]))
+                ++position;
+            utf8.insert(position, utf8_errors[generator() % (sizeof(utf8_errors) / sizeof(utf8_errors[0]))]);
+
+            const char16_t* error = utf16_errors[generator() % (sizeof(utf16_errors) / sizeof(utf16_errors[0]))];
+            position = generator() % (utf16.size() + 1);
+            if(position > 0 && unicpp::is_utf16_lead_surrogate(utf16[position - 1]))
+                --position;
+            utf16.insert(position, error, error[1] ? 2 : 1);
+        }
+
+        const char* utf8_begin = utf8.data();
+        const char* utf8_end = utf8_begin + utf8.size();
+        const char16_t* utf16_begin = utf16.data();
+        const char16_t* utf16_end = utf16_begin + utf16.size();
+        std::wstring wide(utf16.begin(), utf16.end());
+
+        std::string expected_utf16 = conversion_outcome([&]() {
+            std::vector<char16_t> output(unicpp::utf16_length_from_utf8(utf8_begin, utf8_end));
+            return as_bytes(output.data(), unicpp::utf8_to_utf16(utf8_begin, utf8_end, output.data()));
+        });
+        std::string expected_utf8 = conversion_outcome([&]() {
+            std::vector<char> output(unicpp::utf8_length_from_utf16(utf16_begin, utf16_end));
+            return as_bytes(output.data(), unicpp::utf16_to_utf8(utf16_begin, utf16_end, output.data()));
+        });
+        REQUIRE((expected_utf16.compare(0, 4, "ok: ") == 0) != with_error);
+        REQUIRE((expected_utf8.compare(0, 4, "ok: ") == 0) != with_error);
+
+        for(auto level : levels)
+        {
+            REQUIRE(conversion_outcome([&]() {
+                std::vector<char16_t> output(unicpp::utf16_length_from_utf8(utf8_begin, utf8_end));
+                return as_bytes(output.data(), unicpp::transcode_utf8_to_utf16(utf8_begin, utf8_end, output.data(), level));
+            }) == expected_utf16);
+
+            REQUIRE(conversion_outcome([&]() {
+                std::vector<char> output(unicpp::utf8_length_from_utf16(utf16_begin, utf16_end));
+                return as_bytes(output.data(), unicpp::transcode_utf16_to_utf8(utf16_begin, utf16_end, output.data(), level));
+            }) == expected_utf8);
+
+            // The wide strings hold the same code units where wchar_t is 16 bits wide
+            if(sizeof(wchar_t) == 2)
+            {
+                REQUIRE(conversion_outcome([&]() {
+                    std::vector<wchar_t> output(unicpp::utf16_length_from_utf8(utf8_begin, utf8_end));
+                    return as_bytes(output.data(), unicpp::transcode_utf8_to_wide(utf8_begin, utf8_end, output.data(), level));
+                }) == expected_utf16);
+
+                REQUIRE(conversion_outcome([&]() {
+                    std::vector<char> output(unicpp::utf8_length_from_utf16(wide.data(), wide.data() + wide.size()));
+                    return as_bytes(output.data(), unicpp::transcode_wide_to_utf8(wide.data(), wide.data() + wide.size(), output.data(), level));
+                }) == expected_utf8);
+            }
+        }
+    }
+}
+
+TEST_CASE("Vectorized UTF-32 transcoding")
+{
+    std::vector<unicpp::simd_level> levels{unicpp::simd_level::scalar};
+    if(unicpp::get_simd_level() >= unicpp::simd_level::sse42)
+        levels.push_back(unicpp::simd_level::sse42);
+    if(unicpp::get_simd_level() >= unicpp::simd_level::avx2)
+        levels.push_back(unicpp::simd_level::avx2);
+
+    const char* utf8_pieces[] = {
+        "a", "abcdefghijklmnop", u8"é", u8"߿", u8"ࠀ", u8"时", u8"", u8"\U00010000", u8"\U0001F78A", u8"\U0010FFFF",
+        "\xE0\x80\x80", "\xF0\x80\x81\x81"
+    };
+    const char* utf8_errors[] = {"\xFF", "\xBF", "\xC1\xBF", "\xED\xBF\xBF", "\xEF\xBF\xBF", "\xF0\x9F", "\xF5\x80\x80\x80"};
+
+    const char32_t utf32_pieces[] = {U'a', U'~', U'é', 0x7FF, 0x800, U'时', 0xD7FF, 0xE000, 0xFFFD, 0x10000, 0x1F78A, 0x10FFFF};
+    const char32_t utf32_errors[] = {0xD800, 0xDFFF, 0xFFFE, 0xFFFF, 0x110000, 0xFFFFFFFF};
+
+    std::mt19937 generator(13);
+    for(int i = 0; i < 3000; ++i)
+    {
+        std::size_t length = generator() % (i % 10 ? 200 : 5000);
+        bool with_error = (i % 3 == 0);
+
+        std::string utf8;
+        std::u32string utf32;
+        while(utf8.size() < length)
+            utf8 += utf8_pieces[generator() % (sizeof(utf8_pieces) / sizeof(utf8_pieces[0]))];
+        while(utf32.size() < length)
+        {
+            // Runs of ASCII, as in most texts
+            if(generator() % 4 == 0)
+                utf32.append(generator() % 40, U'x');
+            else
+                utf32 += utf32_pieces[generator() % (sizeof(utf32_pieces) / sizeof(utf32_pieces[0]))];
+        }
+
+        if(with_error)
+        {
+            std::size_t position = generator() % (utf8.size() + 1);
+            while(position < utf8.size() && unicpp::is_trail_octet(utf8[position]))
+                ++position;
+            utf8.insert(position, utf8_errors[generator() % (sizeof(utf8_errors) / sizeof(utf8_errors[0]))]);
+
+            position = generator() % (utf32.size() + 1);
+            utf32.insert(utf32.begin() + position, utf32_errors[generator() % (sizeof(utf32_errors) / sizeof(utf32_errors[0]))]);
+        }
+
+        const char* utf8_begin = utf8.data();
+        const char* utf8_end = utf8_begin + utf8.size();
+        const char32_t* utf32_begin = utf32.data();
+        const char32_t* utf32_end = utf32_begin + utf32.size();
+        std::wstring wide(utf32.begin(), utf32.end());
+
+        std::string expected_utf32 = conversion_outcome([&]() {
+            std::vector<char32_t> output(unicpp::utf32_length_from_utf8(utf8_begin, utf8_end));
+            return as_bytes(output.data(), unicpp::utf8_to_utf32(utf8_begin, utf8_end, output.data()));
+        });
+        std::string expected_utf8 = conversion_outcome([&]() {
+            std::vector<char> output(unicpp::utf8_length_from_utf32(utf32_begin, utf32_end));
+            return as_bytes(output.data(), unicpp::utf32_to_utf8(utf32_begin, utf32_end, output.data()));
+        });
+        REQUIRE((expected_utf32.compare(0, 4, "ok: ") == 0) != with_error);
+        REQUIRE((expected_utf8.compare(0, 4, "ok: ") == 0) != with_error);
+
+        for(auto level : levels)
+        {
+            REQUIRE(conversion_outcome([&]() {
+                std::vector<char32_t> output(unicpp::utf32_length_from_utf8(utf8_begin, utf8_end));
+                return as_bytes(output.data(), unicpp::transcode_utf8_to_utf32(utf8_begin, utf8_end, output.data(), level));
+            }) == expected_utf32);
+
+            REQUIRE(conversion_outcome([&]() {
+                std::vector<char> output(unicpp::utf8_length_from_utf32(utf32_begin, utf32_end));
+                return as_bytes(output.data(), unicpp::transcode_utf32_to_utf8(utf32_begin, utf32_end, output.data(), level));
+            }) == expected_utf8);
+
+            // The wide strings hold the same code units where wchar_t is 32 bits wide
+            if(sizeof(wchar_t) == 4)
+            {
+                REQUIRE(conversion_outcome([&]() {
+                    std::vector<wchar_t> output(unicpp::utf32_length_from_utf8(utf8_begin, utf8_end));
+                    return as_bytes(output.data(), unicpp::transcode_utf8_to_wide(utf8_begin, utf8_end, output.data(), level));
+                }) == expected_utf32);
+
+                REQUIRE(conversion_outcome([&]() {
+                    std::vector<char> output(unicpp::utf8_length_from_utf32(wide.data(), wide.data() + wide.size()));
+                    return as_bytes(output.data(), unicpp::transcode_wide_to_utf8(wide.data(), wide.data() + wide.size(), output.data(), level));
+                }) == expected_utf8);
+            }
+        }
+    }
+}
+
+// The predicates are usable in constant expressions
+static_assert(unicpp::get_lead_octet_sequence_length(0xE2) == 3, "E2 starts a 3 octets sequence");
+static_assert(unicpp::is_trail_octet(0xBF) && !unicpp::is_lead_octet(0xBF), "BF is a trail octet");
+static_assert(!unicpp::is_valid_utf8_octet(0xC0) && unicpp::is_valid_utf8_octet(0xC2), "C0 never appears in UTF-8");
+static_assert(!unicpp::is_valid_codepoint(0xD800) && unicpp::is_valid_codepoint(0x1F78A), "Surrogates are not codepoints");
+static_assert(unicpp::is_utf16_surrogate(0xDC00) && !unicpp::is_utf16_lead_surrogate(0xDC00), "DC00 is a trail surrogate");
+
+TEST_CASE("Octet predicates")
+{
+    for(int i = 0; i <= 0xFF; ++i)
+    {
+        unsigned char octet = static_cast<unsigned char>(i);
+
+        std::size_t length = 0;
+        if(octet <= 0x7F)
+            length = 1;
+        else if((octet >> 5) == 0x6)
+            length = 2;
+        else if((octet >> 4) == 0xE)
+            length = 3;
+        else if((octet >> 3) == 0x1E)
+            length = 4;
+
+        REQUIRE(unicpp::get_lead_octet_sequence_length(octet) == length);
+        REQUIRE(unicpp::is_lead_octet(octet) == (length != 0));
+        REQUIRE(unicpp::is_trail_octet(octet) == ((octet >> 6) == 0x2));
+        REQUIRE(unicpp::is_valid_utf8_octet(octet) == (octet != 0xC0 && octet != 0xC1 && octet != 0xF5 && octet != 0xFF));
+    }
+}